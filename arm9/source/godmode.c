@@ -50,6 +50,143 @@ typedef struct {
     u32 scroll;
 } PaneData;
 
+#ifdef MONITOR_HEAP
+// allocation tracking for this file, each allocation is tagged with the calling function
+// allocations from other files only show up in mem_allocated()
+#define HEAPTRACK_N_ALLOCS  256
+#define HEAPTRACK_N_TAGS    64
+#define HEAPTRACK_REPORT    "gm9heap.txt"
+
+typedef struct {
+    void* ptr;
+    u32 size;
+    u32 seq;
+    const char* tag;
+} HeapTrackAlloc;
+
+typedef struct {
+    const char* tag;
+    u32 curr;
+    u32 peak;
+    u32 n_allocs;
+} HeapTrackTag;
+
+static HeapTrackAlloc heaptrack_allocs[HEAPTRACK_N_ALLOCS];
+static HeapTrackTag heaptrack_tags[HEAPTRACK_N_TAGS];
+static u32 heaptrack_seq = 0;
+static u32 heaptrack_curr = 0;
+static u32 heaptrack_peak = 0;
+
+HeapTrackTag* HeapTrackGetTag(const char* tag) {
+    for (u32 i = 0; i < HEAPTRACK_N_TAGS; i++) {
+        if (heaptrack_tags[i].tag == tag) return &(heaptrack_tags[i]); // __func__ is unique per function
+        if (!heaptrack_tags[i].tag) {
+            heaptrack_tags[i].tag = tag;
+            return &(heaptrack_tags[i]);
+        }
+    }
+    return NULL;
+}
+
+void* HeapTrackMalloc(size_t size, const char* tag) {
+    void* ptr = malloc(size);
+    if (!ptr) return NULL;
+
+    HeapTrackTag* htag = HeapTrackGetTag(tag);
+    for (u32 i = 0; htag && (i < HEAPTRACK_N_ALLOCS); i++) {
+        if (heaptrack_allocs[i].ptr) continue;
+        heaptrack_allocs[i].ptr = ptr;
+        heaptrack_allocs[i].size = size;
+        heaptrack_allocs[i].seq = ++heaptrack_seq;
+        heaptrack_allocs[i].tag = tag;
+        htag->curr += size;
+        htag->n_allocs++;
+        if (htag->curr > htag->peak) htag->peak = htag->curr;
+        heaptrack_curr += size;
+        if (heaptrack_curr > heaptrack_peak) heaptrack_peak = heaptrack_curr;
+        break;
+    }
+
+    return ptr;
+}
+
+void HeapTrackFree(void* ptr) {
+    for (u32 i = 0; ptr && (i < HEAPTRACK_N_ALLOCS); i++) {
+        if (heaptrack_allocs[i].ptr != ptr) continue;
+        HeapTrackTag* htag = HeapTrackGetTag(heaptrack_allocs[i].tag);
+        if (htag) htag->curr -= heaptrack_allocs[i].size;
+        heaptrack_curr -= heaptrack_allocs[i].size;
+        heaptrack_allocs[i].ptr = NULL;
+        break;
+    }
+    free(ptr);
+}
+
+// largest single block malloc() can still provide, compared to the free total this shows fragmentation
+u32 HeapTrackLargestFree(void) {
+    u32 lo = 0;
+    u32 hi = 64 * 1024 * 1024;
+    while (hi - lo > 0x1000) {
+        u32 mid = lo + ((hi - lo) / 2);
+        void* ptr = malloc(mid);
+        if (ptr) lo = mid;
+        else hi = mid;
+        free(ptr);
+    }
+    return lo;
+}
+
+u32 HeapTrackMark(void) {
+    return heaptrack_seq;
+}
+
+// writes the heap report support file, leaks are allocations made after mark that are still live
+u32 HeapTrackReport(u32 mark, const char* menu) {
+    char* report = (char*) malloc(0x4000);
+    char currstr[32];
+    char peakstr[32];
+    u32 n_leaks = 0;
+    u32 len = 0;
+    if (!report) return 0;
+
+    FormatBytes(currstr, heaptrack_curr);
+    FormatBytes(peakstr, heaptrack_peak);
+    len += snprintf(report + len, 0x4000 - len, "heap report after %s\ntracked: %s (peak %s)\n", menu, currstr, peakstr);
+    FormatBytes(currstr, mem_allocated());
+    FormatBytes(peakstr, HeapTrackLargestFree());
+    len += snprintf(report + len, 0x4000 - len, "mem_allocated(): %s\nlargest free block: %s\n\n", currstr, peakstr);
+
+    for (u32 i = 0; (i < HEAPTRACK_N_TAGS) && heaptrack_tags[i].tag && (len < 0x3F00); i++) {
+        FormatBytes(currstr, heaptrack_tags[i].curr);
+        FormatBytes(peakstr, heaptrack_tags[i].peak);
+        len += snprintf(report + len, 0x4000 - len, "%-24.24s %10s %10s %6lu\n", heaptrack_tags[i].tag,
+            currstr, peakstr, heaptrack_tags[i].n_allocs);
+    }
+
+    for (u32 i = 0; i < HEAPTRACK_N_ALLOCS; i++) {
+        if (!heaptrack_allocs[i].ptr || (heaptrack_allocs[i].seq <= mark)) continue;
+        if (!n_leaks++ && (len < 0x3F00)) len += snprintf(report + len, 0x4000 - len, "\nleaks:\n");
+        if (len < 0x3F00) len += snprintf(report + len, 0x4000 - len, "%-24.24s %08lX byte\n",
+            heaptrack_allocs[i].tag, heaptrack_allocs[i].size);
+    }
+
+    SaveSupportFile(HEAPTRACK_REPORT, report, min(len, 0x4000));
+    free(report);
+    return n_leaks;
+}
+
+void HeapTrackCheck(u32 mark, const char* menu) {
+    u32 n_leaks = HeapTrackReport(mark, menu);
+    if (n_leaks) ShowPrompt(false, "%s: %lu 件のメモリリーク\n詳細: " HEAPTRACK_REPORT, menu, n_leaks);
+}
+
+#define malloc(size)    HeapTrackMalloc(size, __func__)
+#define free(ptr)       HeapTrackFree(ptr)
+#else
+#define HeapTrackMark()             0
+#define HeapTrackCheck(mark, menu)  ((void) (mark))
+#endif
+
 
 u32 BootFirmHandler(const char* bootpath, bool verbose, bool delete) {
     char pathstr[UTF_BUFFER_BYTESIZE(32)];
@@ -162,6 +299,222 @@ static DirStruct* current_dir = NULL;
 static DirStruct* clipboard   = NULL;
 static PaneData* panedata     = NULL;
 
+#define FTCACHE_N_ENTRIES   1024 // must be a power of two
+#define FTCACHE_N_WAYS      4 // set associative, so a few hash collisions don't evict entries
+#define FTCACHE_N_SETS      (FTCACHE_N_ENTRIES / FTCACHE_N_WAYS)
+#define FTCACHE_VALID       (1UL<<0)
+#define FTCACHE_HAS_TID     (1UL<<1)
+#define FTCACHE_HAS_TRIM    (1UL<<2)
+
+typedef struct {
+    u32 path_hash;
+    u32 flags;
+    u64 fsize;
+    u32 fdatetime; // FAT date (hi) / time (lo)
+    u32 reserved;
+    u64 filetype;
+    u64 tid;
+    u64 trimsize;
+} FileTypeCacheEntry;
+
+static FileTypeCacheEntry ftcache[FTCACHE_N_ENTRIES] = { 0 };
+static u32 ftcache_victim = 0;
+
+u32 FileTypeCacheHash(const char* path) {
+    u32 hash = 0x811C9DC5; // FNV-1a
+    for (; *path; path++) hash = (hash ^ (u8) *path) * 0x01000193;
+    return hash;
+}
+
+void FileTypeCacheFlush(void) {
+    memset(ftcache, 0x00, sizeof(ftcache));
+}
+
+// valid entry for hash, or NULL (free_entry gets a free or victim slot of the set then)
+FileTypeCacheEntry* FileTypeCacheFind(u32 hash, FileTypeCacheEntry** free_entry) {
+    FileTypeCacheEntry* set = &(ftcache[(hash & (FTCACHE_N_SETS-1)) * FTCACHE_N_WAYS]);
+    FileTypeCacheEntry* unused = NULL;
+    for (u32 w = 0; w < FTCACHE_N_WAYS; w++) {
+        if (!(set[w].flags & FTCACHE_VALID)) {
+            if (!unused) unused = &(set[w]);
+        } else if (set[w].path_hash == hash) return &(set[w]);
+    }
+    if (free_entry) *free_entry = (unused) ? unused : &(set[ftcache_victim++ % FTCACHE_N_WAYS]);
+    return NULL;
+}
+
+void FileTypeCacheInvalidate(const char* path) {
+    FileTypeCacheEntry* entry = FileTypeCacheFind(FileTypeCacheHash(path), NULL);
+    if (entry) entry->flags = 0;
+}
+
+// only files on FAT drives are cached, virtual files may change behind the same path
+FileTypeCacheEntry* FileTypeCacheGet(const char* path) {
+    FILINFO fno;
+    if (!(DriveType(path) & DRV_FAT) || (fvx_stat(path, &fno) != FR_OK) || (fno.fattrib & AM_DIR))
+        return NULL;
+
+    u32 hash = FileTypeCacheHash(path);
+    u32 fdatetime = ((u32) fno.fdate << 16) | fno.ftime;
+    FileTypeCacheEntry* slot = NULL;
+    FileTypeCacheEntry* entry = FileTypeCacheFind(hash, &slot);
+    if (entry && ((entry->fsize != fno.fsize) || (entry->fdatetime != fdatetime))) {
+        slot = entry; // file changed, identify again in place
+        entry = NULL;
+    }
+    if (!entry) {
+        entry = slot;
+        memset(entry, 0x00, sizeof(FileTypeCacheEntry));
+        entry->path_hash = hash;
+        entry->fsize = fno.fsize;
+        entry->fdatetime = fdatetime;
+        entry->filetype = IdentifyFileType(path);
+        entry->flags = FTCACHE_VALID;
+    }
+
+    return entry;
+}
+
+u64 IdentifyFileTypeCached(const char* path, u64* tid) {
+    FileTypeCacheEntry* entry = FileTypeCacheGet(path);
+    if (!entry) { // uncacheable, identify directly
+        if (tid) *tid = GetGameFileTitleId(path);
+        return IdentifyFileType(path);
+    }
+
+    if (tid) {
+        if (!(entry->flags & FTCACHE_HAS_TID)) {
+            entry->tid = GetGameFileTitleId(path);
+            entry->flags |= FTCACHE_HAS_TID;
+        }
+        *tid = entry->tid;
+    }
+
+    return entry->filetype;
+}
+
+u64 GetGameFileTrimmedSizeCached(const char* path) {
+    FileTypeCacheEntry* entry = FileTypeCacheGet(path);
+    if (!entry) return GetGameFileTrimmedSize(path);
+
+    if (!(entry->flags & FTCACHE_HAS_TRIM)) {
+        entry->trimsize = GetGameFileTrimmedSize(path);
+        entry->flags |= FTCACHE_HAS_TRIM;
+    }
+
+    return entry->trimsize;
+}
+
+#define ARENA_SIZE          (2 * STD_BUFFER_SIZE) // two I/O buffers (differential restore), the most used at once
+#define ARENA_ALIGN         0x20
+
+// scoped bump allocator on a pool allocated once at startup, used for all large I/O and scratch buffers
+// everything allocated after a mark goes away with ArenaRelease(), heap is only used as fallback
+typedef struct {
+    u32 top;
+    u32 n_fallback;
+} ArenaMarker;
+
+// in front of each (aligned) heap fallback block, fallbacks form a stack released via the markers
+typedef struct ArenaFallback {
+    void* raw;
+    struct ArenaFallback* next;
+} ArenaFallback;
+
+static u8* arena_pool = NULL;
+static u32 arena_size = 0;
+static u32 arena_top = 0;
+static ArenaFallback* arena_fallback = NULL;
+static u32 arena_n_fallback = 0;
+
+void ArenaInit(void) {
+    if (arena_pool) return;
+    u8* raw = (u8*) malloc(ARENA_SIZE + ARENA_ALIGN); // malloc() alignment is less than ARENA_ALIGN
+    arena_pool = (raw) ? (u8*) align((u32) raw, ARENA_ALIGN) : NULL;
+    arena_size = (raw) ? ARENA_SIZE : 0;
+    arena_top = 0;
+}
+
+void* ArenaAlloc(u32 size) {
+    u32 asize = align(size, ARENA_ALIGN);
+    if (asize && (arena_top + asize <= arena_size)) {
+        void* ptr = arena_pool + arena_top;
+        arena_top += asize;
+        return ptr;
+    }
+    u8* raw = (u8*) malloc(size + sizeof(ArenaFallback) + ARENA_ALIGN);
+    if (!raw) return NULL;
+    u8* ptr = (u8*) align((u32) (raw + sizeof(ArenaFallback)), ARENA_ALIGN);
+    ArenaFallback* fallback = (ArenaFallback*) (ptr - sizeof(ArenaFallback));
+    fallback->raw = raw;
+    fallback->next = arena_fallback;
+    arena_fallback = fallback;
+    arena_n_fallback++;
+    return ptr;
+}
+
+ArenaMarker ArenaMark(void) {
+    ArenaMarker marker = { arena_top, arena_n_fallback };
+    return marker;
+}
+
+void ArenaRelease(ArenaMarker marker) {
+    while (arena_fallback && (arena_n_fallback > marker.n_fallback)) {
+        ArenaFallback* fallback = arena_fallback;
+        arena_fallback = fallback->next;
+        arena_n_fallback--;
+        free(fallback->raw);
+    }
+    if (marker.top < arena_top) arena_top = marker.top;
+}
+
+#define IOCHUNK_CFG     "gm9iochunk.cfg"
+#define IOCLASS_SD      0
+#define IOCLASS_NAND    1
+#define IOCLASS_CART    2
+#define IOCLASS_RAM     3
+#define IOCLASS_OTHER   4
+#define IOCLASS_N       5
+
+// chunk size per (source, destination) drive class, from the benchmark or STD_BUFFER_SIZE
+static u32 iochunk_policy[IOCLASS_N][IOCLASS_N];
+static bool iochunk_loaded = false;
+
+u32 GetIoClass(const char* path) {
+    u64 drvtype = DriveType(path);
+    if (drvtype & DRV_CART) return IOCLASS_CART;
+    if (drvtype & DRV_RAMDRIVE) return IOCLASS_RAM;
+    if (drvtype & DRV_SYSNAND) return IOCLASS_NAND;
+    if (drvtype & (DRV_SDCARD|DRV_EMUNAND|DRV_ALIAS)) return IOCLASS_SD; // EmuNAND lives on the SD card
+    return IOCLASS_OTHER;
+}
+
+// sector aligned chunk size for copy / dump loops, never more than STD_BUFFER_SIZE
+// (the buffers are STD_BUFFER_SIZE big, so the policy can only ever shrink the chunk below that)
+u32 GetIoChunkSize(const char* src, const char* dst) {
+    if (!iochunk_loaded) {
+        if (!LoadSupportFile(IOCHUNK_CFG, iochunk_policy, sizeof(iochunk_policy)))
+            memset(iochunk_policy, 0x00, sizeof(iochunk_policy));
+        iochunk_loaded = true;
+    }
+    u32 chunk = iochunk_policy[src ? GetIoClass(src) : IOCLASS_OTHER][dst ? GetIoClass(dst) : IOCLASS_OTHER];
+    if (!chunk || (chunk > STD_BUFFER_SIZE)) return STD_BUFFER_SIZE;
+    return (chunk < 0x200) ? 0x200 : (chunk & ~0x1FF);
+}
+
+u32 SetIoChunkPolicy(u32* best_read, u32* best_write) {
+    for (u32 s = 0; s < IOCLASS_N; s++) {
+        for (u32 d = 0; d < IOCLASS_N; d++) {
+            // unmeasured classes keep the default, otherwise the smaller preference of both sides
+            u32 chunk = (best_read[s] && best_write[d]) ? min(best_read[s], best_write[d]) :
+                best_read[s] ? best_read[s] : best_write[d];
+            iochunk_policy[s][d] = chunk;
+        }
+    }
+    iochunk_loaded = true;
+    return SaveSupportFile(IOCHUNK_CFG, iochunk_policy, sizeof(iochunk_policy)) ? 0 : 1;
+}
+
 void GetTimeString(char* timestr, bool forced_update, bool full_year) {
     static DsTime dstime;
     static u64 timer = (u64) -1; // this ensures we don't check the time too often
@@ -418,6 +771,45 @@ void DrawDirContents(DirStruct* contents, u32 cursor, u32* scroll) {
     } else DrawRectangle(ALT_SCREEN, SCREEN_WIDTH_ALT - bar_width, start_y, bar_width, flist_height, COLOR_STD_BG);
 }
 
+// cluster size by FAT partition size, a heuristic only: the card's allocation unit is not known here,
+// larger cards tend to have larger ones and bigger clusters keep more writes aligned to them
+// returns 0 (FatFs picks a valid size) if the partition would have too few clusters for FAT32
+u32 SdAutoClusterSize(u64 fat_size_mb) {
+    u32 cluster_size = (fat_size_mb <= 2048) ? 0x4000 : (fat_size_mb <= 32768) ? 0x8000 : 0x10000;
+    if (((fat_size_mb << 20) / cluster_size) < 65525) return 0;
+    return cluster_size;
+}
+
+// reads SysNAND once and writes each chunk to all EmuNAND bases
+u32 CloneSysNandToEmuNands(const u32* bases, u32 n_bases, u32 n_sectors) {
+    u32 chunk_sectors = GetIoChunkSize("S:", "E:") / 0x200;
+    u32 ret = 0;
+
+    ArenaMarker arena_mark = ArenaMark();
+    u8* buf = (u8*) ArenaAlloc(STD_BUFFER_SIZE);
+    if (!buf) return 1;
+
+    ShowProgress(0, 0, "SysNAND -> EmuNAND");
+    for (u32 s = 0; (s < n_sectors) && !ret; s += chunk_sectors) {
+        u32 count = min(chunk_sectors, n_sectors - s);
+        if (ReadNandSectors(buf, s, count, 0xFF, NAND_SYSNAND) != 0) {
+            ret = 1;
+            break;
+        }
+        for (u32 i = 0; i < n_bases; i++) {
+            SetEmuNandBase(bases[i]);
+            if (WriteNandSectors(buf, s, count, 0xFF, NAND_EMUNAND) != 0) {
+                ret = 1;
+                break;
+            }
+        }
+        if (!ShowProgress(s + count, n_sectors, "SysNAND -> EmuNAND")) ret = 1;
+    }
+
+    ArenaRelease(arena_mark);
+    return ret;
+}
+
 u32 SdFormatMenu(const char* slabel) {
     static const u32 cluster_size_table[5] = { 0x0, 0x0, 0x4000, 0x8000, 0x10000 };
     static const char* option_emunand_size[7] = { "EmuNANDを作らない", "RedNAND 容量 (最小)", "GW EmuNAND 容量 (最大)",
@@ -454,6 +846,7 @@ u32 SdFormatMenu(const char* slabel) {
 
     user_select = ShowSelectPrompt(4, option_cluster_size, "SDカードをフォーマットしますか (%lluMB)?\nCクラスター容量選択:", sdcard_size_mb);
     if (!user_select) return 1;
+    else if (user_select == 1) cluster_size = SdAutoClusterSize(sdcard_size_mb - emunand_size_mb);
     else cluster_size = cluster_size_table[user_select];
 
     snprintf(label, DRV_LABEL_LEN + 4, "0:%s", (slabel && *slabel) ? slabel : "GM9SD");
@@ -482,19 +875,15 @@ u32 SdFormatMenu(const char* slabel) {
         } else user_select = ShowPrompt(true, "SysNANDをRedNANDにクローンしますか") ? 1 : 0;
         if (!user_select) return 0;
 
-        u8 ncsd[0x200];
-        u32 flags = OVERRIDE_PERM;
-        InitSDCardFS(); // this has to be initialized for EmuNAND to work
+        u32 bases[4];
+        u32 n_bases = 0;
         for (u32 i = 0; i < n_emunands; i++) {
             if ((i * sysnand_multi_size_mb) + sysnand_min_size_mb > emunand_size_mb) break;
-            SetEmuNandBase((i * sysnand_multi_size_mb * 0x100000 / 0x200) + emunand_offset);
-            if ((ReadNandSectors(ncsd, 0, 1, 0xFF, NAND_SYSNAND) != 0) ||
-                (WriteNandSectors(ncsd, 0, 1, 0xFF, NAND_EMUNAND) != 0) ||
-                (!PathCopy("E:", "S:/nand_minsize.bin", &flags))) {
-                ShowPrompt(false, "SysNANDからEmuNANDへのクローニングに失敗しました!");
-                break;
-            }
+            bases[n_bases++] = (i * sysnand_multi_size_mb * 0x100000 / 0x200) + emunand_offset;
         }
+        InitSDCardFS(); // this has to be initialized for EmuNAND to work
+        if (CloneSysNandToEmuNands(bases, n_bases, sysnand_min_size_sectors) != 0)
+            ShowPrompt(false, "SysNANDからEmuNANDへのクローニングに失敗しました!");
         DeinitSDCardFS();
     }
 
@@ -505,7 +894,8 @@ u32 FileGraphicsViewer(const char* path) {
     const u32 max_size = SCREEN_SIZE(ALT_SCREEN);
     u64 filetype = IdentifyFileType(path);
     u16* bitmap = NULL;
-    u8* input = (u8*)malloc(max_size);
+    ArenaMarker arena_mark = ArenaMark();
+    u8* input = (u8*) ArenaAlloc(max_size);
     u32 w = 0;
     u32 h = 0;
     u32 ret = 1;
@@ -530,15 +920,16 @@ u32 FileGraphicsViewer(const char* path) {
     } else ret = 1;
 
     free(bitmap);
-    free(input);
+    ArenaRelease(arena_mark);
     return ret;
 }
 
 u32 FileHexViewer(const char* path) {
     const u32 max_data = (SCREEN_HEIGHT / FONT_HEIGHT_EXT) * 16 * ((FONT_WIDTH_EXT > 4) ? 1 : 2);
     static u32 mode = 0;
+    ArenaMarker arena_mark = ArenaMark();
     u8* data = NULL;
-    u8* bottom_cpy = (u8*) malloc(SCREEN_SIZE_BOT); // a copy of the bottom screen framebuffer
+    u8* bottom_cpy = (u8*) ArenaAlloc(SCREEN_SIZE_BOT); // a copy of the bottom screen framebuffer
     u32 fsize = FileGetSize(path);
 
     bool dual_screen = 0;
@@ -558,15 +949,13 @@ u32 FileHexViewer(const char* path) {
 
     static const u32 edit_bsize = 0x4000; // should be multiple of 0x200 * 2
     bool edit_mode = false;
-    u8* buffer = (u8*) malloc(edit_bsize);
-    u8* buffer_cpy = (u8*) malloc(edit_bsize);
+    u8* buffer = (u8*) ArenaAlloc(edit_bsize);
+    u8* buffer_cpy = (u8*) ArenaAlloc(edit_bsize);
     u32 edit_start = 0;
     int cursor = 0;
 
     if (!bottom_cpy || !buffer || !buffer_cpy) {
-        if (bottom_cpy) free(bottom_cpy);
-        if (buffer) free(buffer);
-        if (buffer_cpy) free(buffer_cpy);
+        ArenaRelease(arena_mark);
         return 1;
     }
 
@@ -838,12 +1227,311 @@ u32 FileHexViewer(const char* path) {
     if (MAIN_SCREEN == TOP_SCREEN) memcpy(BOT_SCREEN, bottom_cpy, SCREEN_SIZE_BOT);
     else ClearScreen(BOT_SCREEN, COLOR_STD_BG);
 
-    free(bottom_cpy);
-    free(buffer);
-    free(buffer_cpy);
+    ArenaRelease(arena_mark);
     return 0;
 }
 
+// word-wise check for blocks consisting of a single repeated byte (size must be a multiple of 4)
+bool CheckFillBlock(const void* data, u32 size, u8* fill) {
+    const u32* data32 = (const u32*) data;
+    u32 fill32;
+    if (!size || (size & 0x3)) return false;
+    *fill = *(const u8*) data;
+    fill32 = *fill * 0x01010101UL;
+    for (u32 i = 0; i < size / 4; i++)
+        if (data32[i] != fill32) return false;
+    return true;
+}
+
+// FileCreateDummy() only allocates, this explicitly overwrites the whole file with zeros
+u32 FileZeroFill(const char* path) {
+    FIL file;
+    u32 ret = 0;
+
+    ArenaMarker arena_mark = ArenaMark();
+    u8* buf = (u8*) ArenaAlloc(STD_BUFFER_SIZE);
+    if (!buf) return 1;
+    memset(buf, 0x00, STD_BUFFER_SIZE);
+
+    if (fvx_open(&file, path, FA_WRITE | FA_OPEN_EXISTING) != FR_OK) {
+        ArenaRelease(arena_mark);
+        return 1;
+    }
+    u64 fsize = fvx_size(&file);
+    u32 chunk = GetIoChunkSize(NULL, path);
+    ShowProgress(0, 0, path);
+    for (u64 p = 0; p < fsize; p += chunk) {
+        u64 len = min((fsize - p), chunk);
+        UINT bw;
+        if ((fvx_write(&file, buf, len, &bw) != FR_OK) || (bw != len) ||
+            !ShowProgress(p + len, fsize, path)) {
+            ret = 1;
+            break;
+        }
+    }
+    fvx_close(&file);
+
+    ArenaRelease(arena_mark);
+    return ret;
+}
+
+// injects orig into dest at offset, unaligned head / tail go through the FS sector buffer,
+// everything in between is written in large sector aligned chunks
+// falls back to FileInjectFile() for expanding or in-file injects
+bool FileInjectAligned(const char* dest, const char* orig, u64 offset) {
+    FIL dfile;
+    FIL ofile;
+    bool ret = true;
+
+    u64 osize = FileGetSize(orig);
+    if ((strncasecmp(dest, orig, 256) == 0) || (offset + osize > FileGetSize(dest)))
+        return FileInjectFile(dest, orig, (u32) offset, 0, 0, NULL);
+    if (!CheckWritePermissions(dest)) return false;
+
+    ArenaMarker arena_mark = ArenaMark();
+    u8* buf = (u8*) ArenaAlloc(STD_BUFFER_SIZE);
+    if (!buf) return false;
+
+    if (fvx_open(&ofile, orig, FA_READ | FA_OPEN_EXISTING) != FR_OK) {
+        ArenaRelease(arena_mark);
+        return false;
+    }
+    if ((fvx_open(&dfile, dest, FA_WRITE | FA_OPEN_EXISTING) != FR_OK) ||
+        (fvx_lseek(&dfile, offset) != FR_OK)) {
+        fvx_close(&ofile);
+        ArenaRelease(arena_mark);
+        return false;
+    }
+
+    u32 chunk = GetIoChunkSize(orig, dest);
+    ShowProgress(0, 0, orig);
+    u64 head = (offset % 0x200) ? min(0x200 - (offset % 0x200), osize) : 0;
+    for (u64 p = 0; ret && (p < osize);) {
+        u64 len = (p < head) ? head : min(osize - p, chunk);
+        if (len > 0x200) len &= ~0x1FFULL; // keep the tail sector separate
+        UINT br, bw;
+        if ((fvx_read(&ofile, buf, len, &br) != FR_OK) || (br != len) ||
+            (fvx_write(&dfile, buf, len, &bw) != FR_OK) || (bw != len) ||
+            !ShowProgress(p + len, osize, orig))
+            ret = false;
+        p += len;
+    }
+
+    fvx_close(&dfile);
+    fvx_close(&ofile);
+    ArenaRelease(arena_mark);
+    return ret;
+}
+
+void FormatThroughput(char* tpstr, u64 nbytes, u64 msec) {
+    char bytestr[32];
+    char ratestr[32];
+    FormatBytes(bytestr, nbytes);
+    FormatBytes(ratestr, msec ? ((nbytes * 1000) / msec) : nbytes);
+    snprintf(tpstr, 64, "%s / %llu.%llus (%s/s)", bytestr, msec / 1000, (msec % 1000) / 100, ratestr);
+}
+
+#define OUTSNAP_N_ENTRIES   1024
+#define OUTSNAP_UNKNOWN     ((u64) -1)
+
+// size_in is the size of the input files (not a count of bytes read), size_out OUTSNAP_UNKNOWN if not known
+void FormatBuildStats(char* statstr, u64 size_in, u64 size_out, u64 msec) {
+    char instr[32];
+    char tpstr[64];
+    FormatBytes(instr, size_in);
+    if (size_out == OUTSNAP_UNKNOWN) snprintf(tpstr, 64, "n/a / %llu.%llus", msec / 1000, (msec % 1000) / 100);
+    else FormatThroughput(tpstr, size_out, msec);
+    snprintf(statstr, 128, "入力: %s\n出力: %s", instr, tpstr);
+}
+
+// name hash, size and timestamp of each file in a dir, to find the files an operation actually wrote
+typedef struct {
+    u32 name_hash;
+    u32 fdatetime;
+    u64 fsize;
+} OutputSnapEntry;
+
+typedef struct {
+    u32 n_entries;
+    bool overflow; // more files than entries, the snapshot can't tell old from new then
+    OutputSnapEntry entry[OUTSNAP_N_ENTRIES];
+} OutputSnapshot;
+
+void TakeOutputSnapshot(OutputSnapshot* snap, const char* path) {
+    DIR pdir;
+    FILINFO fno;
+    snap->n_entries = 0;
+    snap->overflow = false;
+    if (fvx_opendir(&pdir, path) != FR_OK) return; // no dir yet, everything in it later is new
+    while ((fvx_readdir(&pdir, &fno) == FR_OK) && *(fno.fname)) {
+        if (fno.fattrib & AM_DIR) continue;
+        if (snap->n_entries >= OUTSNAP_N_ENTRIES) {
+            snap->overflow = true;
+            break;
+        }
+        OutputSnapEntry* entry = &(snap->entry[snap->n_entries++]);
+        entry->name_hash = FileTypeCacheHash(fno.fname);
+        entry->fdatetime = ((u32) fno.fdate << 16) | fno.ftime;
+        entry->fsize = fno.fsize;
+    }
+    fvx_closedir(&pdir);
+}
+
+// total size of files in path that are new or were rewritten (size or timestamp changed) since the snapshot
+// OUTSNAP_UNKNOWN if the snapshot overflowed
+u64 GetOutputSnapshotDelta(const OutputSnapshot* snap, const char* path) {
+    DIR pdir;
+    FILINFO fno;
+    u64 nbytes = 0;
+    if (snap->overflow) return OUTSNAP_UNKNOWN;
+    if (fvx_opendir(&pdir, path) != FR_OK) return 0;
+    while ((fvx_readdir(&pdir, &fno) == FR_OK) && *(fno.fname)) {
+        if (fno.fattrib & AM_DIR) continue;
+        u32 name_hash = FileTypeCacheHash(fno.fname);
+        u32 fdatetime = ((u32) fno.fdate << 16) | fno.ftime;
+        u32 i = 0;
+        for (; i < snap->n_entries; i++) {
+            const OutputSnapEntry* entry = &(snap->entry[i]);
+            if ((entry->name_hash == name_hash) && (entry->fdatetime == fdatetime) &&
+                (entry->fsize == fno.fsize)) break;
+        }
+        if (i >= snap->n_entries) nbytes += fno.fsize;
+    }
+    fvx_closedir(&pdir);
+    return nbytes;
+}
+
+// open addressing set of title ids, 0 marks a free slot, n_slots must be a power of two
+bool TitleIdSetInsert(u64* set, u32 n_slots, u64 tid) {
+    u32 slot = (u32) ((tid ^ (tid >> 32)) * 0x9E3779B1) & (n_slots - 1);
+    for (u32 n = 0; n < n_slots; n++, slot = (slot + 1) & (n_slots - 1)) {
+        if (set[slot] == tid) return false;
+        if (!set[slot]) {
+            set[slot] = tid;
+            return true;
+        }
+    }
+    return false; // set is full
+}
+
+bool TitleIdSetContains(const u64* set, u32 n_slots, u64 tid) {
+    u32 slot = (u32) ((tid ^ (tid >> 32)) * 0x9E3779B1) & (n_slots - 1);
+    for (u32 n = 0; (n < n_slots) && set[slot]; n++, slot = (slot + 1) & (n_slots - 1))
+        if (set[slot] == tid) return true;
+    return false;
+}
+
+#define DIFF_CLUSTER_SECTORS    0x20 // 16KiB compare granularity
+#define DIFF_MAX_PROTECTED      10
+
+// sectors kept from the current SysNAND, never written by the differential restore:
+// NCSD header, embedded essential backup, secret sector (0x00 ... 0x96) and FIRM partitions
+u32 GetNandProtectedRanges(u32* start, u32* count) {
+    NandPartitionInfo np_info;
+    u32 n = 0;
+    start[n] = 0x00; count[n++] = 0x97;
+    for (u32 i = 0; (n < DIFF_MAX_PROTECTED) &&
+        (GetNandPartitionInfo(&np_info, NP_TYPE_FIRM, NP_SUBTYPE_CTR, i, NAND_SYSNAND) == 0); i++) {
+        start[n] = np_info.sector;
+        count[n++] = np_info.count;
+    }
+    return n;
+}
+
+bool IsNandSectorProtected(u32 sector, u32* start, u32* count, u32 n_ranges) {
+    for (u32 i = 0; i < n_ranges; i++)
+        if ((sector >= start[i]) && (sector < start[i] + count[i])) return true;
+    return false;
+}
+
+// compares image and SysNAND per cluster and only writes clusters that differ
+u32 DiffRestoreNandDump(const char* path, u64* changed, u64* compared) {
+    u32 prot_start[DIFF_MAX_PROTECTED];
+    u32 prot_count[DIFF_MAX_PROTECTED];
+    u32 n_prot;
+    u32 n_sectors;
+    u32 ret = 0;
+
+    *changed = *compared = 0;
+    if (ValidateNandDump(path) != 0) {
+        ShowPrompt(false, "%s\nNANDダンプが壊れているか、\nこの本体のものではありません", path);
+        return 1;
+    }
+
+    // image partitioning has to match SysNAND exactly, as the image header itself is never written
+    NandNcsdHeader ncsd_img;
+    NandNcsdHeader ncsd_loc;
+    if ((fvx_qread(path, &ncsd_img, 0, sizeof(NandNcsdHeader), NULL) != FR_OK) ||
+        (ReadNandSectors((u8*) &ncsd_loc, 0, 1, 0xFF, NAND_SYSNAND) != 0) ||
+        (ValidateNandNcsdHeader(&ncsd_img) != 0) || (ValidateNandNcsdHeader(&ncsd_loc) != 0))
+        return 1;
+    for (u32 p = 0; p < 8; p++) {
+        if ((ncsd_img.partitions[p].offset != ncsd_loc.partitions[p].offset) ||
+            (ncsd_img.partitions[p].size != ncsd_loc.partitions[p].size) ||
+            (ncsd_img.partitions_fs_type[p] != ncsd_loc.partitions_fs_type[p]) ||
+            (ncsd_img.partitions_crypto_type[p] != ncsd_loc.partitions_crypto_type[p])) {
+            ShowPrompt(false, "%s\nNCSDパーティションがSysNANDと一致しません", path);
+            return 1;
+        }
+    }
+
+    // only the partitioned area (NAND min size) is restored, anything beyond it (bonus drive) stays
+    n_sectors = GetNandMinSizeSectors(NAND_SYSNAND);
+    if (FileGetSize(path) < (u64) n_sectors * 0x200) return 1;
+    if (!CheckWritePermissions("S:/nand.bin")) return 1;
+    n_prot = GetNandProtectedRanges(prot_start, prot_count);
+
+    ArenaMarker arena_mark = ArenaMark();
+    u8* buf_img = (u8*) ArenaAlloc(STD_BUFFER_SIZE);
+    u8* buf_nand = (u8*) ArenaAlloc(STD_BUFFER_SIZE);
+    if (!buf_img || !buf_nand) {
+        ArenaRelease(arena_mark);
+        return 1;
+    }
+
+    // no cancel from here on, a partial restore would leave a mixed NAND
+    DismountDriveType(DRV_SYSNAND);
+    ShowProgress(0, 0, path);
+    u32 chunk_sectors = GetIoChunkSize(path, "S:") / 0x200;
+    for (u32 s = 0; (s < n_sectors) && !ret; s += chunk_sectors) {
+        u32 count = min(chunk_sectors, n_sectors - s);
+        if ((fvx_qread(path, buf_img, (u64) s * 0x200, count * 0x200, NULL) != FR_OK) ||
+            (ReadNandSectors(buf_nand, s, count, 0xFF, NAND_SYSNAND) != 0)) {
+            ret = 1;
+            break;
+        }
+        for (u32 c = 0; c < count; c += DIFF_CLUSTER_SECTORS) {
+            u32 c_count = min(DIFF_CLUSTER_SECTORS, count - c);
+            if (memcmp(buf_img + (c * 0x200), buf_nand + (c * 0x200), c_count * 0x200) == 0)
+                continue;
+            // write the cluster in runs around protected sectors
+            for (u32 i = 0; i < c_count;) {
+                if (IsNandSectorProtected(s + c + i, prot_start, prot_count, n_prot)) {
+                    i++;
+                    continue;
+                }
+                u32 run = 1;
+                while ((i + run < c_count) &&
+                    !IsNandSectorProtected(s + c + i + run, prot_start, prot_count, n_prot)) run++;
+                if (WriteNandSectors(buf_img + ((c + i) * 0x200), s + c + i, run, 0xFF, NAND_SYSNAND) != 0) {
+                    ret = 1;
+                    break;
+                }
+                *changed += run * 0x200;
+                i += run;
+            }
+            if (ret) break;
+        }
+        *compared += count * 0x200;
+        ShowProgress(s + count, n_sectors, path);
+    }
+
+    ArenaRelease(arena_mark);
+    InitExtFS();
+    FileTypeCacheFlush();
+    return ret;
+}
+
 u32 ShaCalculator(const char* path, bool sha1) {
     const u8 hashlen = sha1 ? 20 : 32;
     u32 drvtype = DriveType(path);
@@ -992,35 +1680,120 @@ u32 CartRawDump(void) {
         OUTPUT_PATH, cname, dsize, (cdata->cart_type & CART_CTR) ? "3ds" : "nds");
 
     // buffer allocation
-    u8* buf = (u8*) malloc(STD_BUFFER_SIZE);
+    ArenaMarker arena_mark = ArenaMark();
+    u8* buf = (u8*) ArenaAlloc(STD_BUFFER_SIZE);
     if (!buf) { // this will not happen
         free(cdata);
         return 1;
     }
 
-    // actual cart dump
-    u32 ret = 0;
+    // actual cart dump, file is kept open and preallocated to the full size
+    FIL file;
     PathDelete(dest);
-    ShowProgress(0, 0, cname);
-    for (u64 p = 0; p < dsize; p += STD_BUFFER_SIZE) {
-        u64 len = min((dsize - p), STD_BUFFER_SIZE);
+    bool is_open = (fvx_open(&file, dest, FA_WRITE | FA_CREATE_ALWAYS) == FR_OK);
+    u32 ret = (is_open && (fvx_lseek(&file, dsize) == FR_OK) && (fvx_tell(&file) == dsize) &&
+        (fvx_lseek(&file, 0) == FR_OK)) ? 0 : 1;
+    u32 chunk = GetIoChunkSize("C:", dest);
+    if (!ret) ShowProgress(0, 0, cname);
+    for (u64 p = 0; !ret && (p < dsize); p += chunk) {
+        u64 len = min((dsize - p), chunk);
+        UINT bw;
         if ((ReadCartBytes(buf, p, len, cdata, false) != 0) ||
-            (fvx_qwrite(dest, buf, p, len, NULL) != FR_OK) ||
-            !ShowProgress(p, dsize, cname)) {
-            PathDelete(dest);
+            (fvx_write(&file, buf, len, &bw) != FR_OK) || (bw != len) ||
+            !ShowProgress(p, dsize, cname))
             ret = 1;
-            break;
-        }
     }
+    if (is_open) fvx_close(&file);
+    if (ret) PathDelete(dest);
 
     if (ret) ShowPrompt(false, "%s\nカートダンプに失敗", cname);
     else ShowPrompt(false, "%s\nダンプ %s", cname, OUTPUT_PATH);
     
-    free(buf);
+    ArenaRelease(arena_mark);
     free(cdata);
     return ret;
 }
 
+typedef struct {
+    u32 index; // in the DirStruct
+    bool collision;
+    char name[256];
+} GoodRenamePlan;
+
+// same target name and exclusions as GoodRenamer(), false if the file is to be left alone
+bool GetGoodRenameTarget(char* goodname, const DirEntry* entry) {
+    if (GetGoodName(goodname, entry->path, false) != 0) return false;
+    u32 len = strnlen(goodname, 256);
+    if ((len >= 4) && (strncmp(goodname + len - 4, ".tmd", 4) == 0)) return false; // no TMD, please
+    return (strncmp(goodname, entry->name, 256) != 0);
+}
+
+// returns the number of renamed files, (u32) -1 if the user only looked at the plan
+u32 GoodRenamerBatch(DirStruct* contents, u32 n_marked, bool dry_run, u32* n_collisions) {
+    ArenaMarker arena_mark = ArenaMark();
+    GoodRenamePlan* plan = (GoodRenamePlan*) ArenaAlloc(n_marked * sizeof(GoodRenamePlan));
+    u32 n_plan = 0;
+    u32 n_success = 0;
+    *n_collisions = 0;
+    if (!plan) return 0;
+
+    // one sequential pass over the dir, reading headers and getting all target names
+    ShowProgress(0, 0, "");
+    for (u32 i = 0; (i < contents->n_entries) && (n_plan < n_marked); i++) {
+        DirEntry* entry = &(contents->entry[i]);
+        if (!entry->marked) continue;
+        ShowProgress(i+1, contents->n_entries, entry->name);
+        if (!GetGoodRenameTarget(plan[n_plan].name, entry)) continue;
+        plan[n_plan].index = i;
+        plan[n_plan].collision = false;
+        n_plan++;
+    }
+
+    // target names must not collide with each other or with existing entries (FAT is case insensitive)
+    for (u32 p = 0; p < n_plan; p++) {
+        for (u32 q = p + 1; q < n_plan; q++) {
+            if (strncasecmp(plan[p].name, plan[q].name, 256) != 0) continue;
+            plan[p].collision = plan[q].collision = true;
+        }
+        for (u32 i = 0; (i < contents->n_entries) && !plan[p].collision; i++) {
+            if (i == plan[p].index) continue;
+            if (strncasecmp(plan[p].name, contents->entry[i].name, 256) == 0)
+                plan[p].collision = true;
+        }
+        if (plan[p].collision) (*n_collisions)++;
+    }
+
+    if (dry_run) { // show the plan, then ask
+        char* planstr = (char*) ArenaAlloc(STD_BUFFER_SIZE);
+        u32 len = 0;
+        bool apply = false;
+        if (planstr) {
+            len = snprintf(planstr, STD_BUFFER_SIZE, "%lu ファイル, %lu 変更, %lu 衝突\n \n",
+                n_marked, n_plan - *n_collisions, *n_collisions);
+            for (u32 p = 0; (p < n_plan) && (len + 2*256 + 32 < STD_BUFFER_SIZE); p++)
+                len += snprintf(planstr + len, STD_BUFFER_SIZE - len, "%s%s\n -> %s\n",
+                    plan[p].collision ? "[衝突] " : "", contents->entry[plan[p].index].name, plan[p].name);
+            MemTextViewer(planstr, len, 1, false);
+            apply = (n_plan > *n_collisions) && ShowPrompt(true, "%lu ファイルの名前を変更しますか?", n_plan - *n_collisions);
+        }
+        if (!apply) {
+            ArenaRelease(arena_mark);
+            return (u32) -1;
+        }
+    }
+
+    // apply renames in directory order
+    for (u32 p = 0; p < n_plan; p++) {
+        DirEntry* entry = &(contents->entry[plan[p].index]);
+        if (plan[p].collision) continue;
+        if (!ShowProgress(p+1, n_plan, plan[p].name)) break;
+        if (PathRename(entry->path, plan[p].name)) n_success++;
+    }
+
+    ArenaRelease(arena_mark);
+    return n_success;
+}
+
 u32 DirFileAttrMenu(const char* path, const char *name) {
     bool drv = (path[2] == '\0');
     bool vrt = (!drv); // will be checked below
@@ -1147,9 +1920,9 @@ u32 FileHandlerMenu(char* current_path, u32* cursor, u32* scroll, PaneData** pan
     // check for file lock
     if (!FileUnlock(file_path)) return 1;
 
-    u64 filetype = IdentifyFileType(file_path);
+    u64 tid = 0;
+    u64 filetype = IdentifyFileTypeCached(file_path, &tid);
     u32 drvtype = DriveType(file_path);
-    u64 tid = GetGameFileTitleId(file_path);
 
     bool in_output_path = (strncasecmp(current_path, OUTPUT_PATH, 256) == 0);
 
@@ -1202,7 +1975,7 @@ u32 FileHandlerMenu(char* current_path, u32* cursor, u32* scroll, PaneData** pan
     if ((filetype & GAME_TMD) &&
         (GetTmdContentPath(cxi_path, file_path) == 0) &&
         (PathExist(cxi_path))) {
-        u64 filetype_cxi = IdentifyFileType(cxi_path);
+        u64 filetype_cxi = IdentifyFileTypeCached(cxi_path, NULL);
         mountable = (FTYPE_MOUNTABLE(filetype_cxi) && !(drvtype & DRV_IMAGE));
         extrcodeable = (FTYPE_HASCODE(filetype_cxi));
     }
@@ -1299,6 +2072,7 @@ u32 FileHandlerMenu(char* current_path, u32* cursor, u32* scroll, PaneData** pan
         "%s%0.0s\n(%lu 選択されたファイル)" : "%s%s", pathstr, tidstr, n_marked);
     if (user_select == hexviewer) { // -> show in hex viewer
         FileHexViewer(file_path);
+        FileTypeCacheInvalidate(file_path);
         GetDirContents(current_dir, current_path);
         return 0;
     }
@@ -1373,8 +2147,9 @@ u32 FileHandlerMenu(char* current_path, u32* cursor, u32* scroll, PaneData** pan
         TruncateString(origstr, clipboard->entry[0].name, 18, 10);
         u64 offset = ShowHexPrompt(0, 8, "%s からデータを導入しますか?\nオフセットは下記でご指定ください。", origstr);
         if (offset != (u64) -1) {
-            if (!FileInjectFile(file_path, clipboard->entry[0].path, (u32) offset, 0, 0, NULL))
+            if (!FileInjectAligned(file_path, clipboard->entry[0].path, offset))
                 ShowPrompt(false, "導入の失敗 %s", origstr);
+            FileTypeCacheInvalidate(file_path);
             clipboard->n_entries = 0;
         }
         return 0;
@@ -1491,6 +2266,7 @@ u32 FileHandlerMenu(char* current_path, u32* cursor, u32* scroll, PaneData** pan
         if (clipboard->n_entries && (DriveType(clipboard->entry[0].path) & DRV_IMAGE))
             clipboard->n_entries = 0; // remove last mounted image clipboard entries
         SetTitleManagerMode(false); // disable title manager mode
+        FileTypeCacheFlush(); // image drive contents change
         InitImgFS((filetype & GAME_TMD) ? cxi_path : file_path);
 
         const char* drv_path = NULL; // find path of mounted drive
@@ -1532,12 +2308,15 @@ u32 FileHandlerMenu(char* current_path, u32* cursor, u32* scroll, PaneData** pan
             u32 n_success = 0;
             u32 n_unencrypted = 0;
             u32 n_other = 0;
+            u64 n_bytes = 0;
+            u64 timer = timer_start();
+            char tpstr[64];
             ShowString(" %lu ファイルの復号化を試みています。...", n_marked);
             for (u32 i = 0; i < current_dir->n_entries; i++) {
                 const char* path = current_dir->entry[i].path;
                 if (!current_dir->entry[i].marked)
                     continue;
-                if (!(IdentifyFileType(path) & filetype & TYPE_BASE)) {
+                if (!(IdentifyFileTypeCached(path, NULL) & filetype & TYPE_BASE)) {
                     n_other++;
                     continue;
                 }
@@ -1546,20 +2325,26 @@ u32 FileHandlerMenu(char* current_path, u32* cursor, u32* scroll, PaneData** pan
                     continue;
                 }
                 DrawDirContents(current_dir, (*cursor = i), scroll);
+                if (inplace) FileTypeCacheInvalidate(path);
                 if (!(filetype & BIN_KEYDB) && (CryptGameFile(path, inplace, false) == 0)) n_success++;
                 else if ((filetype & BIN_KEYDB) && (CryptAesKeyDb(path, inplace, false) == 0)) n_success++;
                 else { // on failure: show error, continue
                     char lpathstr[UTF_BUFFER_BYTESIZE(32)];
                     TruncateString(lpathstr, path, 32, 8);
-                    if (ShowPrompt(true, "%s\n復号化に失敗\n \n続けますか?", lpathstr)) continue;
+                    u64 prompt_start = timer_start();
+                    bool cont = ShowPrompt(true, "%s\n復号化に失敗\n \n続けますか?", lpathstr);
+                    timer += timer_start() - prompt_start; // time spent at the prompt doesn't count
+                    if (cont) continue;
                     else break;
                 }
+                n_bytes += current_dir->entry[i].size;
                 current_dir->entry[i].marked = false;
             }
+            FormatThroughput(tpstr, n_bytes, timer_msec(timer));
             if (n_other || n_unencrypted) {
-                ShowPrompt(false, "%lu/%lu 復号化されました\n%lu/%lu 非暗号化\n%lu/%lu 種類が異なる",
-                    n_success, n_marked, n_unencrypted, n_marked, n_other, n_marked);
-            } else ShowPrompt(false, "%lu/%lu 復号化されました", n_success, n_marked);
+                ShowPrompt(false, "%lu/%lu 復号化されました\n%lu/%lu 非暗号化\n%lu/%lu 種類が異なる\n \n%s",
+                    n_success, n_marked, n_unencrypted, n_marked, n_other, n_marked, tpstr);
+            } else ShowPrompt(false, "%lu/%lu 復号化されました\n \n%s", n_success, n_marked, tpstr);
             if (!inplace && n_success) ShowPrompt(false, "%lu に書き込まれたファイル。 %s", n_success, OUTPUT_PATH);
         } else {
             if (!(filetype & BIN_KEYDB) && (CheckEncryptedGameFile(file_path) != 0)) {
@@ -1567,6 +2352,7 @@ u32 FileHandlerMenu(char* current_path, u32* cursor, u32* scroll, PaneData** pan
             } else {
                 u32 ret = (filetype & BIN_KEYDB) ? CryptAesKeyDb(file_path, inplace, false) :
                     CryptGameFile(file_path, inplace, false);
+                if (inplace) FileTypeCacheInvalidate(file_path);
                 if (inplace || (ret != 0)) ShowPrompt(false, "%s\n復号化 %s", pathstr, (ret == 0) ? "成功" : "失敗");
                 else ShowPrompt(false, "%s\n暗号化 %s", pathstr, OUTPUT_PATH);
             }
@@ -1585,34 +2371,44 @@ u32 FileHandlerMenu(char* current_path, u32* cursor, u32* scroll, PaneData** pan
         } else if ((n_marked > 1) && ShowPrompt(true, "選択したすべての %lu ファイルを暗号化しますか?", n_marked)) {
             u32 n_success = 0;
             u32 n_other = 0;
+            u64 n_bytes = 0;
+            u64 timer = timer_start();
+            char tpstr[64];
             ShowString(" %lu ファイルの暗号化を試みています...", n_marked);
             for (u32 i = 0; i < current_dir->n_entries; i++) {
                 const char* path = current_dir->entry[i].path;
                 if (!current_dir->entry[i].marked)
                     continue;
-                if (!(IdentifyFileType(path) & filetype & TYPE_BASE)) {
+                if (!(IdentifyFileTypeCached(path, NULL) & filetype & TYPE_BASE)) {
                     n_other++;
                     continue;
                 }
                 DrawDirContents(current_dir, (*cursor = i), scroll);
+                if (inplace) FileTypeCacheInvalidate(path);
                 if (!(filetype & BIN_KEYDB) && (CryptGameFile(path, inplace, true) == 0)) n_success++;
                 else if ((filetype & BIN_KEYDB) && (CryptAesKeyDb(path, inplace, true) == 0)) n_success++;
                 else { // on failure: show error, continue
                     char lpathstr[UTF_BUFFER_BYTESIZE(32)];
                     TruncateString(lpathstr, path, 32, 8);
-                    if (ShowPrompt(true, "%s\n暗号化に失敗\n \n続けますか?", lpathstr)) continue;
+                    u64 prompt_start = timer_start();
+                    bool cont = ShowPrompt(true, "%s\n暗号化に失敗\n \n続けますか?", lpathstr);
+                    timer += timer_start() - prompt_start; // time spent at the prompt doesn't count
+                    if (cont) continue;
                     else break;
                 }
+                n_bytes += current_dir->entry[i].size;
                 current_dir->entry[i].marked = false;
             }
+            FormatThroughput(tpstr, n_bytes, timer_msec(timer));
             if (n_other) {
-                ShowPrompt(false, "%lu/%lu ファイルを暗号化しました\n%lu/%lu 種類が異なる",
-                    n_success, n_marked, n_other, n_marked);
-            } else ShowPrompt(false, "%lu ファイルを暗号化しました", n_success, n_marked);
+                ShowPrompt(false, "%lu/%lu ファイルを暗号化しました\n%lu/%lu 種類が異なる\n \n%s",
+                    n_success, n_marked, n_other, n_marked, tpstr);
+            } else ShowPrompt(false, "%lu/%lu ファイルを暗号化しました\n \n%s", n_success, n_marked, tpstr);
             if (!inplace && n_success) ShowPrompt(false, "%lu　ファイルが　%s　に書き込まれました。", n_success, OUTPUT_PATH);
         } else {
             u32 ret = (filetype & BIN_KEYDB) ? CryptAesKeyDb(file_path, inplace, true) :
                 CryptGameFile(file_path, inplace, true);
+            if (inplace) FileTypeCacheInvalidate(file_path);
             if (inplace || (ret != 0)) ShowPrompt(false, "%s\n暗号化 %s", pathstr, (ret == 0) ? "成功" : "失敗");
             else ShowPrompt(false, "%s\n暗号化 %s", pathstr, OUTPUT_PATH);
         }
@@ -1621,14 +2417,21 @@ u32 FileHandlerMenu(char* current_path, u32* cursor, u32* scroll, PaneData** pan
     else if ((user_select == cia_build) || (user_select == cia_build_legit) || (user_select == cxi_dump)) { // -> build CIA / dump CXI
         char* type = (user_select == cxi_dump) ? "CXI" : "CIA";
         bool force_legit = (user_select == cia_build_legit);
+        ArenaMarker arena_mark = ArenaMark();
+        OutputSnapshot* snap = (OutputSnapshot*) ArenaAlloc(sizeof(OutputSnapshot));
+        if (!snap) return 1;
+        TakeOutputSnapshot(snap, OUTPUT_PATH);
+        char iostr[128];
         if ((n_marked > 1) && ShowPrompt(true, "選択されたすべての%luファイルを処理しようとしますか?", n_marked)) {
             u32 n_success = 0;
             u32 n_other = 0;
+            u64 n_input = 0;
+            u64 timer = timer_start();
             for (u32 i = 0; i < current_dir->n_entries; i++) {
                 const char* path = current_dir->entry[i].path;
                 if (!current_dir->entry[i].marked)
                     continue;
-                if (!(IdentifyFileType(path) & filetype & TYPE_BASE)) {
+                if (!(IdentifyFileTypeCached(path, NULL) & filetype & TYPE_BASE)) {
                     n_other++;
                     continue;
                 }
@@ -1638,14 +2441,20 @@ u32 FileHandlerMenu(char* current_path, u32* cursor, u32* scroll, PaneData** pan
                 else { // on failure: show error, continue
                     char lpathstr[UTF_BUFFER_BYTESIZE(32)];
                     TruncateString(lpathstr, path, 32, 8);
-                    if (ShowPrompt(true, "%s\n　%s 構築に失敗しました\n \n続けますか?", lpathstr, type)) continue;
+                    u64 prompt_start = timer_start();
+                    bool cont = ShowPrompt(true, "%s\n　%s 構築に失敗しました\n \n続けますか?", lpathstr, type);
+                    timer += timer_start() - prompt_start; // time spent at the prompt doesn't count
+                    if (cont) continue;
                     else break;
                 }
+                n_input += current_dir->entry[i].size;
                 current_dir->entry[i].marked = false;
             }
-            if (n_other) ShowPrompt(false, "%lu/%lu %ss 構築しました\n%lu/%lu 種類が異なる",
-                n_success, n_marked, type, n_other, n_marked);
-            else ShowPrompt(false, "%lu/%lu %ss 構築しました", n_success, n_marked, type);
+            u64 msec = timer_msec(timer);
+            FormatBuildStats(iostr, n_input, GetOutputSnapshotDelta(snap, OUTPUT_PATH), msec);
+            if (n_other) ShowPrompt(false, "%lu/%lu %ss 構築しました\n%lu/%lu 種類が異なる\n \n%s",
+                n_success, n_marked, type, n_other, n_marked, iostr);
+            else ShowPrompt(false, "%lu/%lu %ss 構築しました\n \n%s", n_success, n_marked, type, iostr);
             if (n_success) ShowPrompt(false, "%lu　ファイルが　%s　に書き込まれました。", n_success, OUTPUT_PATH);
             if (n_success && in_output_path) GetDirContents(current_dir, current_path);
             if (n_success != (n_marked - n_other)) {
@@ -1653,9 +2462,12 @@ u32 FileHandlerMenu(char* current_path, u32* cursor, u32* scroll, PaneData** pan
                     n_marked - (n_success + n_other));
             }
         } else {
+            u64 timer = timer_start();
             if (((user_select != cxi_dump) && (BuildCiaFromGameFile(file_path, force_legit) == 0)) ||
                 ((user_select == cxi_dump) && (DumpCxiSrlFromGameFile(file_path) == 0))) {
-                ShowPrompt(false, "%s\n%s 構築 %s", pathstr, type, OUTPUT_PATH);
+                u64 msec = timer_msec(timer);
+                FormatBuildStats(iostr, FileGetSize(file_path), GetOutputSnapshotDelta(snap, OUTPUT_PATH), msec);
+                ShowPrompt(false, "%s\n%s 構築 %s\n \n%s", pathstr, type, OUTPUT_PATH, iostr);
                 if (in_output_path) GetDirContents(current_dir, current_path);
             } else {
                 ShowPrompt(false, "%s\n%s 構築に失敗しました", pathstr, type);
@@ -1666,6 +2478,7 @@ u32 FileHandlerMenu(char* current_path, u32* cursor, u32* scroll, PaneData** pan
                 }
             }
         }
+        ArenaRelease(arena_mark);
         return 0;
     }
     else if ((user_select == cia_install) || (user_select == tik_install) ||
@@ -1685,12 +2498,16 @@ u32 FileHandlerMenu(char* current_path, u32* cursor, u32* scroll, PaneData** pan
         if ((n_marked > 1) && ShowPrompt(true, "選択したすべての %lu ファイルをインストールしますか?", n_marked)) {
             u32 n_success = 0;
             u32 n_other = 0;
+            // game and ticket installs both end up in the NAND ticket.db,
+            // so get the permission once instead of in the middle of the batch
+            if ((InstallFunction != &InstallCifinishFile) &&
+                !CheckWritePermissions(to_emunand ? "4:" : "1:")) return 0;
             ShowString("%lu　ファイルのインストールを試みています。...", n_marked);
             for (u32 i = 0; i < current_dir->n_entries; i++) {
                 const char* path = current_dir->entry[i].path;
                 if (!current_dir->entry[i].marked)
                     continue;
-                if (!(IdentifyFileType(path) & filetype & TYPE_BASE)) {
+                if (!(IdentifyFileTypeCached(path, NULL) & filetype & TYPE_BASE)) {
                     n_other++;
                     continue;
                 }
@@ -1741,7 +2558,7 @@ u32 FileHandlerMenu(char* current_path, u32* cursor, u32* scroll, PaneData** pan
             for (u32 i = 0; i < current_dir->n_entries; i++) {
                 const char* path = current_dir->entry[i].path;
                 if (!current_dir->entry[i].marked) continue;
-                if (!(IdentifyFileType(path) & filetype & TYPE_BASE)) continue;
+                if (!(IdentifyFileTypeCached(path, NULL) & filetype & TYPE_BASE)) continue;
                 if (!num && !CheckWritePermissions(path)) break;
                 if (!ShowProgress(num++, n_marked, path)) break;
                 if (UninstallGameDataTie(path, true, full_uninstall, full_uninstall) == 0)
@@ -1763,13 +2580,16 @@ u32 FileHandlerMenu(char* current_path, u32* cursor, u32* scroll, PaneData** pan
             u32 n_success = 0;
             u32 n_other = 0;
             u32 n_processed = 0;
+            u64 n_bytes = 0;
+            u64 timer = timer_start();
+            char tpstr[64];
             for (u32 i = 0; i < current_dir->n_entries; i++) {
                 const char* path = current_dir->entry[i].path;
                 if (!current_dir->entry[i].marked)
                     continue;
                 if (!(filetype & (GAME_CIA|GAME_TMD|GAME_NCSD|GAME_NCCH)) &&
                     !ShowProgress(n_processed++, n_marked, path)) break;
-                if (!(IdentifyFileType(path) & filetype & TYPE_BASE)) {
+                if (!(IdentifyFileTypeCached(path, NULL) & filetype & TYPE_BASE)) {
                     n_other++;
                     continue;
                 }
@@ -1779,22 +2599,31 @@ u32 FileHandlerMenu(char* current_path, u32* cursor, u32* scroll, PaneData** pan
                 else { // on failure: show error, continue
                     char lpathstr[UTF_BUFFER_BYTESIZE(32)];
                     TruncateString(lpathstr, path, 32, 8);
-                    if (ShowPrompt(true, "%s\n検証に失敗しました\n \n続けますか?", lpathstr)) {
+                    u64 prompt_start = timer_start();
+                    bool cont = ShowPrompt(true, "%s\n検証に失敗しました\n \n続けますか?", lpathstr);
+                    timer += timer_start() - prompt_start; // time spent at the prompt doesn't count
+                    if (cont) {
                         if (!(filetype & (GAME_CIA|GAME_TMD|GAME_NCSD|GAME_NCCH)))
                             ShowProgress(0, n_marked, path); // restart progress bar
                         continue;
                     } else break;
                 }
+                n_bytes += current_dir->entry[i].size;
                 current_dir->entry[i].marked = false;
             }
-            if (n_other) ShowPrompt(false, "%lu/%lu 確認されました\n%lu/%lu 種類が異なる",
-                n_success, n_marked, n_other, n_marked);
-            else ShowPrompt(false, "%lu/%lu 確認されました", n_success, n_marked);
+            FormatThroughput(tpstr, n_bytes, timer_msec(timer));
+            if (n_other) ShowPrompt(false, "%lu/%lu 確認されました\n%lu/%lu 種類が異なる\n \n%s",
+                n_success, n_marked, n_other, n_marked, tpstr);
+            else ShowPrompt(false, "%lu/%lu 確認されました\n \n%s", n_success, n_marked, tpstr);
         } else {
             ShowString("%s\nファイルを検証中です、しばらくお待ちください...", pathstr);
             if (filetype & IMG_NAND) {
-                ShowPrompt(false, "%s\nNANDの検証 %s", pathstr,
-                    (ValidateNandDump(file_path) == 0) ? "成功" : "失敗");
+                u64 timer = timer_start();
+                bool valid = (ValidateNandDump(file_path) == 0);
+                char tpstr[64];
+                FormatThroughput(tpstr, FileGetSize(file_path), timer_msec(timer));
+                ShowPrompt(false, "%s\nNANDの検証 %s\n \n%s", pathstr,
+                    valid ? "成功" : "失敗", tpstr);
             } else ShowPrompt(false, "%s\n検証 %s", pathstr,
                 (VerifyGameFile(file_path) == 0) ? "成功" : "失敗");
         }
@@ -1812,7 +2641,7 @@ u32 FileHandlerMenu(char* current_path, u32* cursor, u32* scroll, PaneData** pan
                     if (!ShowProgress(n_processed++, n_marked, path)) break;
                     DrawDirContents(current_dir, (*cursor = i), scroll);
                     if (DumpTicketForGameFile(path, force_legit) == 0) n_success++;
-                    else if (IdentifyFileType(path) & filetype & TYPE_BASE) continue;
+                    else if (IdentifyFileTypeCached(path, NULL) & filetype & TYPE_BASE) continue;
                     if (force_legit) n_legit++;
                     current_dir->entry[i].marked = false;
                 }
@@ -1843,21 +2672,38 @@ u32 FileHandlerMenu(char* current_path, u32* cursor, u32* scroll, PaneData** pan
         if (n_marked > 1) {
             u32 n_success = 0;
             u32 n_other = 0;
+            u32 n_dupes = 0;
+            u32 n_slots = 1;
+            while (n_slots < 2 * n_marked) n_slots <<= 1;
+            ArenaMarker arena_mark = ArenaMark();
+            u64* tidset = (u64*) ArenaAlloc(n_slots * sizeof(u64));
+            if (!tidset) return 1;
+            memset(tidset, 0x00, n_slots * sizeof(u64));
             for (u32 i = 0; i < current_dir->n_entries; i++) {
                 const char* path = current_dir->entry[i].path;
+                u64 tid_l = 0;
                 if (!current_dir->entry[i].marked)
                     continue;
-                if (!FTYPE_TIKBUILD(IdentifyFileType(path))) {
+                if (!FTYPE_TIKBUILD(IdentifyFileTypeCached(path, &tid_l))) {
                     n_other++;
                     continue;
                 }
                 current_dir->entry[i].marked = false;
-                if (BuildTitleKeyInfo(path, dec, false) == 0) n_success++; // ignore failures for now
+                if (tid_l && TitleIdSetContains(tidset, n_slots, tid_l)) {
+                    n_dupes++; // title already in the database, first successful one wins
+                    continue;
+                }
+                if (BuildTitleKeyInfo(path, dec, false) == 0) { // ignore failures for now
+                    if (tid_l) TitleIdSetInsert(tidset, n_slots, tid_l);
+                    n_success++;
+                }
             }
+            ArenaRelease(arena_mark);
             if (BuildTitleKeyInfo(NULL, dec, true) == 0) {
                 if (n_other) ShowPrompt(false, "%s\n%lu/%lu 処理済みファイル\n%lu/%lu ファイル無視",
                     path_out, n_success, n_marked, n_other, n_marked);
                 else ShowPrompt(false, "%s\n%lu/%lu 処理済みファイル", path_out, n_success, n_marked);
+                if (n_dupes) ShowPrompt(false, "%s\n%lu/%lu ファイルは重複タイトルのためスキップ", path_out, n_dupes, n_marked);
             } else ShowPrompt(false, "%s\nデータベースの構築に失敗しました。", path_out);
         } else ShowPrompt(false, "%s\nデータベース構築 %s.", path_out,
             (BuildTitleKeyInfo(file_path, dec, true) == 0) ? "成功" : "失敗");
@@ -1874,7 +2720,7 @@ u32 FileHandlerMenu(char* current_path, u32* cursor, u32* scroll, PaneData** pan
                 const char* path = current_dir->entry[i].path;
                 if (!current_dir->entry[i].marked)
                     continue;
-                if (!FTYPE_KEYBUILD(IdentifyFileType(path))) {
+                if (!FTYPE_KEYBUILD(IdentifyFileTypeCached(path, NULL))) {
                     n_other++;
                     continue;
                 }
@@ -1891,7 +2737,23 @@ u32 FileHandlerMenu(char* current_path, u32* cursor, u32* scroll, PaneData** pan
         return 0;
     }
     else if (user_select == trim) { // -> Game file trimmer
-        if ((n_marked > 1) && ShowPrompt(true, "選択されたすべての %lu ファイルをトリミングしますか?", n_marked)) {
+        u64 reclaimable = 0;
+        char reclaimstr[32];
+        if (n_marked > 1) { // trimmed sizes are cached, a repeated run over the same selection is faster
+            u32 n_scanned = 0;
+            for (u32 i = 0; i < current_dir->n_entries; i++) {
+                const char* path = current_dir->entry[i].path;
+                u64 trimsize_l;
+                if (!current_dir->entry[i].marked) continue;
+                if (!ShowProgress(n_scanned++, n_marked, path)) return 0;
+                if (!(IdentifyFileTypeCached(path, NULL) & filetype & TYPE_BASE)) continue;
+                trimsize_l = GetGameFileTrimmedSizeCached(path);
+                if (trimsize_l && (trimsize_l < current_dir->entry[i].size))
+                    reclaimable += current_dir->entry[i].size - trimsize_l;
+            }
+            FormatBytes(reclaimstr, reclaimable);
+        }
+        if ((n_marked > 1) && ShowPrompt(true, "選択されたすべての %lu ファイルをトリミングしますか?\n \n節約可能: %s", n_marked, reclaimstr)) {
             u32 n_success = 0;
             u32 n_other = 0;
             u32 n_processed = 0;
@@ -1903,7 +2765,7 @@ u32 FileHandlerMenu(char* current_path, u32* cursor, u32* scroll, PaneData** pan
                 if (!current_dir->entry[i].marked)
                     continue;
                 if (!ShowProgress(n_processed++, n_marked, path)) break;
-                if (!(IdentifyFileType(path) & filetype & TYPE_BASE)) {
+                if (!(IdentifyFileTypeCached(path, NULL) & filetype & TYPE_BASE)) {
                     n_other++;
                     continue;
                 }
@@ -1927,7 +2789,7 @@ u32 FileHandlerMenu(char* current_path, u32* cursor, u32* scroll, PaneData** pan
             else ShowPrompt(false, "%lu/%lu トリミングされました\n%s 保存されました", n_success, n_marked, savingsstr);
             if (n_success) GetDirContents(current_dir, current_path);
         } else {
-            u64 trimsize = GetGameFileTrimmedSize(file_path);
+            u64 trimsize = GetGameFileTrimmedSizeCached(file_path);
             u64 currentsize = FileGetSize(file_path);
             char tsizestr[32];
             char csizestr[32];
@@ -1952,18 +2814,20 @@ u32 FileHandlerMenu(char* current_path, u32* cursor, u32* scroll, PaneData** pan
         return 0;
     }
     else if (user_select == rename) { // -> Game file renamer
-        if ((n_marked > 1) && ShowPrompt(true, "選択したすべての %lu ファイルの名前を変更しますか?", n_marked)) {
-            u32 n_success = 0;
-            ShowProgress(0, 0, "");
-            for (u32 i = 0; i < current_dir->n_entries; i++) {
-                DirEntry* entry = &(current_dir->entry[i]);
-                if (!current_dir->entry[i].marked) continue;
-                ShowProgress(i+1, current_dir->n_entries, entry->name);
-                if (!GoodRenamer(entry, false)) continue;
-                n_success++;
-                current_dir->entry[i].marked = false;
+        if (n_marked > 1) {
+            optionstr[0] = "名前を変更";
+            optionstr[1] = "変更計画を表示 (ドライラン)";
+            user_select = (int) ShowSelectPrompt(2, optionstr, "選択したすべての %lu ファイルの名前を変更しますか?", n_marked);
+        }
+        if ((n_marked > 1) && user_select) {
+            u32 n_collisions = 0;
+            u32 n_success = GoodRenamerBatch(current_dir, n_marked, (user_select == 2), &n_collisions);
+            if (n_success != (u32) -1) {
+                if (n_collisions) ShowPrompt(false, "%lu/%lu 名前が変更されました\n%lu/%lu 名前の衝突",
+                    n_success, n_marked, n_collisions, n_marked);
+                else ShowPrompt(false, "%lu/%lu 名前が変更されました", n_success, n_marked);
+                GetDirContents(current_dir, current_path);
             }
-            ShowPrompt(false, "%lu/%lu 名前が変更されました", n_success, n_marked);
         } else if (!GoodRenamer(&(current_dir->entry[*cursor]), true)) {
             ShowPrompt(false, "%s\n良い名前に変更できませんでした", pathstr);
         }
@@ -2001,7 +2865,7 @@ u32 FileHandlerMenu(char* current_path, u32* cursor, u32* scroll, PaneData** pan
                 if (!current_dir->entry[i].marked)
                     continue;
                 if (!ShowProgress(n_processed++, n_marked, path)) break;
-                if (!(IdentifyFileType(path) & filetype & TYPE_BASE)) {
+                if (!(IdentifyFileTypeCached(path, NULL) & filetype & TYPE_BASE)) {
                     n_other++;
                     continue;
                 }
@@ -2051,23 +2915,61 @@ u32 FileHandlerMenu(char* current_path, u32* cursor, u32* scroll, PaneData** pan
         return 0;
     }
     else if (user_select == restore) { // -> restore SysNAND (A9LH preserving)
-        ShowPrompt(false, "%s\nNANDリストア %s", pathstr,
-            (SafeRestoreNandDump(file_path) == 0) ? "成功" : "失敗");
+        optionstr[0] = "フルリストア";
+        optionstr[1] = "差分リストア (変更セクタのみ)";
+        user_select = ShowSelectPrompt(2, optionstr, "%s\nリストア方法を選択", pathstr);
+        if (user_select == 1) {
+            ShowPrompt(false, "%s\nNANDリストア %s", pathstr,
+                (SafeRestoreNandDump(file_path) == 0) ? "成功" : "失敗");
+        } else if (user_select == 2) {
+            u64 changed, compared;
+            u64 timer = timer_start();
+            u32 ret = DiffRestoreNandDump(file_path, &changed, &compared);
+            char changedstr[32];
+            char tpstr[64];
+            FormatBytes(changedstr, changed);
+            FormatThroughput(tpstr, compared, timer_msec(timer));
+            if (clipboard->n_entries && (DriveType(clipboard->entry[0].path) & DRV_SYSNAND))
+                clipboard->n_entries = 0; // remove SysNAND clipboard entries
+            GetDirContents(current_dir, current_path);
+            ShowPrompt(false, "%s\n差分NANDリストア %s\n変更: %s\n比較: %s", pathstr,
+                (ret == 0) ? "成功" : "失敗", changedstr, tpstr);
+        }
         return 0;
     }
     else if (user_select == ncsdfix) { // -> inject sighaxed NCSD
         ShowPrompt(false, "%s\nNCSDを再構築 %s", pathstr,
             (FixNandHeader(file_path, !(filetype == HDR_NAND)) == 0) ? "成功" : "失敗");
+        FileTypeCacheInvalidate(file_path);
         GetDirContents(current_dir, current_path);
         InitExtFS(); // this might have fixed something, so try this
+        FileTypeCacheFlush();
         return 0;
     }
     else if ((user_select == xorpad) || (user_select == xorpad_inplace)) { // -> build xorpads
         bool inplace = (user_select == xorpad_inplace);
-        bool success = (BuildNcchInfoXorpads((inplace) ? current_path : OUTPUT_PATH, file_path) == 0);
-        ShowPrompt(false, "%s\nNCCHinfo padgen %s%s", pathstr,
+        const char* dest = (inplace) ? current_path : OUTPUT_PATH;
+        ArenaMarker arena_mark = ArenaMark();
+        OutputSnapshot* snap = (OutputSnapshot*) ArenaAlloc(sizeof(OutputSnapshot));
+        if (!snap) return 1;
+        TakeOutputSnapshot(snap, dest);
+        u64 timer = timer_start();
+        bool success = (BuildNcchInfoXorpads(dest, file_path) == 0);
+        u64 msec = timer_msec(timer);
+        u64 padsize = GetOutputSnapshotDelta(snap, dest);
+        ArenaRelease(arena_mark);
+        char tpstr[64];
+        char permin[32];
+        if (padsize == OUTSNAP_UNKNOWN) { // too many files in dest to tell the new pads apart
+            snprintf(tpstr, 64, "n/a / %llu.%llus", msec / 1000, (msec % 1000) / 100);
+            snprintf(permin, 32, "n/a");
+        } else {
+            FormatThroughput(tpstr, padsize, msec);
+            FormatBytes(permin, msec ? ((padsize * 60) / msec) * 1000 : padsize);
+        }
+        ShowPrompt(false, "%s\nNCCHinfo padgen %s%s\n \n%s\n(%s/分)", pathstr,
             (success) ? "成功" : "失敗",
-            (!success || inplace) ? "" : "\n出力先: " OUTPUT_PATH);
+            (!success || inplace) ? "" : "\n出力先: " OUTPUT_PATH, tpstr, permin);
         GetDirContents(current_dir, current_path);
         for (; *cursor < current_dir->n_entries; (*cursor)++) {
             DirEntry* entry = &(current_dir->entry[*cursor]);
@@ -2123,12 +3025,13 @@ u32 FileHandlerMenu(char* current_path, u32* cursor, u32* scroll, PaneData** pan
         return 0;
     }
     else if (user_select == font) { // set font
-        u8* font = (u8*) malloc(0x20000); // arbitrary, should be enough by far
+        ArenaMarker arena_mark = ArenaMark();
+        u8* font = (u8*) ArenaAlloc(0x20000); // arbitrary, should be enough by far
         if (!font) return 1;
         u32 font_size = FileGetData(file_path, font, 0x20000, 0);
         if (font_size) SetFont(font, font_size);
         ClearScreenF(true, true, COLOR_STD_BG);
-        free(font);
+        ArenaRelease(arena_mark);
         return 0;
     }
     else if (user_select == view) { // view gfx
@@ -2166,33 +3069,398 @@ u32 FileHandlerMenu(char* current_path, u32* cursor, u32* scroll, PaneData** pan
     return FileHandlerMenu(current_path, cursor, scroll, pane);
 }
 
+#define NANDINC_PATH        OUTPUT_PATH "/nandinc"
+#define NANDINC_MAGIC       "GM9NINC"
+#define NANDINC_BLOCK_SIZE  0x20000 // 128KiB per hashed block
+#define NANDINC_HOLE_ZERO   (1UL<<31) // index table flags for blocks stored as holes
+#define NANDINC_HOLE_FILL   (1UL<<30)
+#define NANDINC_BLOCK_MASK  (NANDINC_HOLE_FILL - 1)
+
+// manifest.bin: header + one SHA-256 per block for the latest state of the chain
+// inc_XXXX.bin: header + changed block data + u32 block index table (0x00/0xFF blocks are holes)
+typedef struct {
+    char magic[8];
+    u32 block_size;
+    u32 n_blocks;
+    u32 n_incs; // increments after the base image
+    u32 index; // index of this increment (0 for the manifest)
+    u32 n_changed; // number of changed blocks (increments only)
+    u32 n_data; // number of changed blocks stored with data (increments only)
+} __attribute__((packed)) NandIncHeader;
+
+// base image on first run, afterwards one increment with the changed blocks
+u32 NandIncBackup(const char* chain_path, u32* n_changed, u32* n_blocks) {
+    NandIncHeader hdr;
+    char path[256];
+    char mpath[256];
+    char bpath[256];
+    char tpath[256];
+    FIL file;
+    bool is_open = false;
+    u32 n_sectors = GetNandSizeSectors(NAND_SYSNAND);
+    u32 block_sectors = NANDINC_BLOCK_SIZE / 0x200;
+    u32 n_data = 0;
+    u32 ret = 0;
+
+    *n_blocks = (n_sectors + block_sectors - 1) / block_sectors;
+    *n_changed = 0;
+
+    ArenaMarker arena_mark = ArenaMark();
+    u8* hashes = (u8*) ArenaAlloc(*n_blocks * 0x20);
+    u32* changed = (u32*) ArenaAlloc(*n_blocks * sizeof(u32));
+    u8* buf = (u8*) ArenaAlloc(NANDINC_BLOCK_SIZE);
+    if (!hashes || !changed || !buf) {
+        ArenaRelease(arena_mark);
+        return 1;
+    }
+
+    // new chain only if neither manifest nor base image exist
+    // an existing chain needs both, and the manifest must match the current SysNAND geometry
+    snprintf(mpath, 256, "%s/manifest.bin", chain_path);
+    snprintf(bpath, 256, "%s/base.bin", chain_path);
+    snprintf(tpath, 256, "%s/manifest.tmp", chain_path);
+    if (!PathExist(mpath) && PathExist(tpath) && PathExist(bpath) &&
+        (FileGetSize(tpath) == sizeof(NandIncHeader) + (*n_blocks * 0x20)) &&
+        (fvx_qread(tpath, &hdr, 0, sizeof(NandIncHeader), NULL) == FR_OK) &&
+        (memcmp(hdr.magic, NANDINC_MAGIC, 8) == 0))
+        PathRename(tpath, "manifest.bin"); // run died between dropping the old and renaming the new manifest
+    bool is_base = !PathExist(mpath) && !PathExist(bpath);
+    if (!is_base && (!PathExist(bpath) ||
+        (fvx_qread(mpath, &hdr, 0, sizeof(NandIncHeader), NULL) != FR_OK) ||
+        (memcmp(hdr.magic, NANDINC_MAGIC, 8) != 0) || (hdr.block_size != NANDINC_BLOCK_SIZE) ||
+        (hdr.n_blocks != *n_blocks) || (fvx_qread(mpath, hashes, sizeof(NandIncHeader), *n_blocks * 0x20, NULL) != FR_OK))) {
+        ShowPrompt(false, "%s\nバックアップチェーンが無効か、\nこのSysNANDと一致しません", chain_path);
+        ret = 1;
+    }
+
+    *path = '\0';
+    if (!ret && is_base) {
+        memset(&hdr, 0, sizeof(NandIncHeader));
+        memcpy(hdr.magic, NANDINC_MAGIC, 8);
+        hdr.block_size = NANDINC_BLOCK_SIZE;
+        hdr.n_blocks = *n_blocks;
+        snprintf(path, 256, "%s", bpath);
+    } else if (!ret) {
+        snprintf(path, 256, "%s/inc_%04lu.bin", chain_path, hdr.n_incs + 1);
+    }
+
+    // one open handle for the whole run, a leftover increment of an aborted run is overwritten
+    if (!ret) {
+        is_open = (fvx_open(&file, path, FA_WRITE | FA_CREATE_ALWAYS) == FR_OK);
+        if (!is_open || (!is_base && (fvx_lseek(&file, sizeof(NandIncHeader)) != FR_OK))) ret = 1;
+    }
+    if (!ret) ShowProgress(0, 0, path);
+    for (u32 b = 0; !ret && (b < *n_blocks); b++) {
+        u32 sector = b * block_sectors;
+        u32 count = min(block_sectors, n_sectors - sector);
+        u8 sha256[0x20];
+        if (ReadNandSectors(buf, sector, count, 0xFF, NAND_SYSNAND) != 0) {
+            ret = 1;
+            break;
+        }
+        sha_quick(sha256, buf, count * 0x200, SHA256_MODE);
+        UINT bw;
+        if (is_base) {
+            if ((fvx_write(&file, buf, count * 0x200, &bw) != FR_OK) || (bw != count * 0x200)) ret = 1;
+            (*n_changed)++;
+        } else if (memcmp(hashes + (b * 0x20), sha256, 0x20) != 0) {
+            u8 fill;
+            if (CheckFillBlock(buf, count * 0x200, &fill) && ((fill == 0x00) || (fill == 0xFF))) {
+                changed[(*n_changed)++] = b | ((fill == 0x00) ? NANDINC_HOLE_ZERO : NANDINC_HOLE_FILL);
+            } else { // data blocks are stored back to back after the header
+                if (count < block_sectors) memset(buf + (count * 0x200), 0x00, NANDINC_BLOCK_SIZE - (count * 0x200));
+                if ((fvx_write(&file, buf, NANDINC_BLOCK_SIZE, &bw) != FR_OK) || (bw != NANDINC_BLOCK_SIZE)) ret = 1;
+                changed[(*n_changed)++] = b;
+                n_data++;
+            }
+        }
+        memcpy(hashes + (b * 0x20), sha256, 0x20);
+        if (!ShowProgress(b + 1, *n_blocks, path)) ret = 1;
+    }
+
+    if (!ret && !is_base) { // write index table and increment header
+        NandIncHeader inc_hdr = hdr;
+        inc_hdr.index = hdr.n_incs + 1;
+        inc_hdr.n_changed = *n_changed;
+        inc_hdr.n_data = n_data;
+        UINT bw0, bw1;
+        if ((fvx_write(&file, changed, *n_changed * sizeof(u32), &bw0) != FR_OK) ||
+            (bw0 != *n_changed * sizeof(u32)) || (fvx_lseek(&file, 0) != FR_OK) ||
+            (fvx_write(&file, &inc_hdr, sizeof(NandIncHeader), &bw1) != FR_OK) || (bw1 != sizeof(NandIncHeader)))
+            ret = 1;
+        else hdr.n_incs++;
+    }
+    if (is_open && (fvx_close(&file) != FR_OK)) ret = 1;
+
+    // manifest is written last via a temp file, so an aborted run keeps the chain intact
+    // (if it dies between delete and rename, the temp file is picked up on the next run)
+    if (!ret) {
+        PathDelete(tpath);
+        if ((fvx_qwrite(tpath, &hdr, 0, sizeof(NandIncHeader), NULL) != FR_OK) ||
+            (fvx_qwrite(tpath, hashes, sizeof(NandIncHeader), *n_blocks * 0x20, NULL) != FR_OK) ||
+            (PathExist(mpath) && !PathDelete(mpath))) {
+            PathDelete(tpath);
+            ret = 1;
+        } else if (!PathRename(tpath, "manifest.bin")) {
+            *path = '\0'; // the temp manifest references the new file now, keep both for recovery
+            ret = 1;
+        }
+    }
+    if (ret && *path) PathDelete(path); // only the file created by this run
+
+    ArenaRelease(arena_mark);
+    return ret;
+}
+
+// rebuilds a full NAND image at point n_inc by streaming base image and increments
+u32 NandIncReconstruct(const char* chain_path, u32 n_inc, const char* dest) {
+    NandIncHeader hdr;
+    char path[256];
+    FIL dfile;
+    FIL ifile;
+    UINT btx;
+    u32 ret = 0;
+
+    ArenaMarker arena_mark = ArenaMark();
+    u8* buf = (u8*) ArenaAlloc(STD_BUFFER_SIZE);
+    if (!buf) return 1;
+
+    // dest and each source file stay open while they are used, no reopen / seek from start per block
+    snprintf(path, 256, "%s/base.bin", chain_path);
+    u64 fsize = FileGetSize(path);
+    u32 chunk = GetIoChunkSize(path, dest);
+    if (fvx_open(&dfile, dest, FA_WRITE | FA_CREATE_ALWAYS) != FR_OK) {
+        ArenaRelease(arena_mark);
+        return 1;
+    }
+    if (fvx_open(&ifile, path, FA_READ | FA_OPEN_EXISTING) != FR_OK) ret = 1;
+    else {
+        ShowProgress(0, 0, dest);
+        for (u64 p = 0; p < fsize; p += chunk) {
+            UINT len = min((fsize - p), chunk);
+            if ((fvx_read(&ifile, buf, len, &btx) != FR_OK) || (btx != len) ||
+                (fvx_write(&dfile, buf, len, &btx) != FR_OK) || (btx != len) ||
+                !ShowProgress(p + len, fsize, dest)) {
+                ret = 1;
+                break;
+            }
+        }
+        fvx_close(&ifile);
+    }
+
+    for (u32 i = 1; !ret && (i <= n_inc); i++) {
+        snprintf(path, 256, "%s/inc_%04lu.bin", chain_path, i);
+        if (fvx_open(&ifile, path, FA_READ | FA_OPEN_EXISTING) != FR_OK) {
+            ret = 1;
+            break;
+        }
+        if ((fvx_read(&ifile, &hdr, sizeof(NandIncHeader), &btx) != FR_OK) || (btx != sizeof(NandIncHeader)) ||
+            (memcmp(hdr.magic, NANDINC_MAGIC, 8) != 0) || (hdr.index != i) ||
+            (hdr.block_size != NANDINC_BLOCK_SIZE) || (hdr.n_changed > hdr.n_blocks) || (hdr.n_data > hdr.n_changed)) {
+            fvx_close(&ifile);
+            ret = 1;
+            break;
+        }
+        if (!hdr.n_changed) {
+            fvx_close(&ifile);
+            continue;
+        }
+        ArenaMarker inc_mark = ArenaMark();
+        u32* changed = (u32*) ArenaAlloc(hdr.n_changed * sizeof(u32));
+        u64 offset = sizeof(NandIncHeader) + ((u64) hdr.n_data * NANDINC_BLOCK_SIZE);
+        if (!changed || (fvx_lseek(&ifile, offset) != FR_OK) ||
+            (fvx_read(&ifile, changed, hdr.n_changed * sizeof(u32), &btx) != FR_OK) ||
+            (btx != hdr.n_changed * sizeof(u32)) || (fvx_lseek(&ifile, sizeof(NandIncHeader)) != FR_OK)) {
+            ArenaRelease(inc_mark);
+            fvx_close(&ifile);
+            ret = 1;
+            break;
+        }
+        // data blocks are stored in index table order, so the increment is read front to back
+        for (u32 c = 0, d = 0; c < hdr.n_changed; c++) {
+            u64 dest_offset = (u64) (changed[c] & NANDINC_BLOCK_MASK) * NANDINC_BLOCK_SIZE;
+            UINT len = (dest_offset < fsize) ? min(fsize - dest_offset, NANDINC_BLOCK_SIZE) : 0;
+            if (changed[c] & (NANDINC_HOLE_ZERO|NANDINC_HOLE_FILL)) {
+                memset(buf, (changed[c] & NANDINC_HOLE_ZERO) ? 0x00 : 0xFF, len);
+            } else if (++d > hdr.n_data) {
+                len = 0;
+            } else {
+                // the full stored block is consumed, the tail past fsize is only padding
+                if ((fvx_read(&ifile, buf, NANDINC_BLOCK_SIZE, &btx) != FR_OK) || (btx != NANDINC_BLOCK_SIZE))
+                    len = 0;
+            }
+            if (!len || (fvx_lseek(&dfile, dest_offset) != FR_OK) ||
+                (fvx_write(&dfile, buf, len, &btx) != FR_OK) || (btx != len)) {
+                ret = 1;
+                break;
+            }
+        }
+        ArenaRelease(inc_mark);
+        fvx_close(&ifile);
+        if (!ShowProgress(i, n_inc, path)) ret = 1;
+    }
+
+    if (fvx_close(&dfile) != FR_OK) ret = 1;
+    if (ret) PathDelete(dest);
+    ArenaRelease(arena_mark);
+    return ret;
+}
+
+#define BENCH_TEST_SIZE     (4UL << 20) // span of each test file
+#define BENCH_MAX_OPS       1024 // caps the number of small block operations per pass
+#define BENCH_N_SIZES       6
+#define BENCH_REPORT        OUTPUT_PATH "/benchmark.txt"
+#define BENCH_SD_FILE       OUTPUT_PATH "/bench.tmp"
+
+static const u32 bench_block_size[BENCH_N_SIZES] = { 0x200, 0x1000, 0x8000, 0x40000, 0x100000, 0x400000 };
+
+// one pass over the test file through a single open handle, so the rate is not dominated by reopening it
+// returns byte/s, the closing flush is part of the measured time
+u64 BenchmarkPass(const char* path, u8* buf, u32 bsize, bool write, bool random) {
+    u32 n_blocks = BENCH_TEST_SIZE / bsize;
+    u32 n_ops = min(n_blocks, BENCH_MAX_OPS);
+    u32 seed = (u32) timer_start();
+    FIL file;
+
+    if (fvx_open(&file, path, (write ? FA_WRITE : FA_READ) | FA_OPEN_EXISTING) != FR_OK)
+        return 0;
+    bool ok = true;
+    u64 timer = timer_start();
+    for (u32 i = 0; ok && (i < n_ops); i++) {
+        u32 blk = i;
+        UINT btx;
+        if (random) {
+            seed = (seed * 1103515245) + 12345;
+            blk = (seed >> 8) % n_blocks;
+        }
+        ok = (fvx_lseek(&file, (u64) blk * bsize) == FR_OK) &&
+            ((write ? fvx_write(&file, buf, bsize, &btx) : fvx_read(&file, buf, bsize, &btx)) == FR_OK) &&
+            (btx == bsize);
+    }
+    ok = (fvx_close(&file) == FR_OK) && ok;
+    u64 msec = timer_msec(timer);
+
+    return ok ? ((u64) n_ops * bsize * 1000) / (msec ? msec : 1) : 0;
+}
+
+// appends one result table for path to the report, write tests need a writable path
+u32 BenchmarkDevice(char* report, u32 max_len, const char* name, const char* path, bool writable, u8* buf, u32 buf_size,
+    u32* best_read, u32* best_write) {
+    u32 len = strnlen(report, max_len);
+    bool prepared = !writable;
+    u64 best_rate[2] = { 0 };
+
+    // the test file is written once beforehand, so read tests never hit unallocated space
+    if (writable) {
+        ShowString("ベンチマーク: %s\nテストファイルを準備中...", name);
+        prepared = true;
+        for (u32 p = 0; prepared && (p < BENCH_TEST_SIZE); p += buf_size)
+            prepared = (fvx_qwrite(path, buf, p, min(buf_size, BENCH_TEST_SIZE - p), NULL) == FR_OK);
+    }
+
+    len += snprintf(report + len, max_len - len, "\n[%s] %s\n%-6s %11s %11s %11s %11s\n", name, path,
+        "block", "seq read", "seq write", "rnd read", "rnd write");
+    for (u32 i = 0; prepared && (i < BENCH_N_SIZES) && (len < max_len); i++) {
+        u32 bsize = bench_block_size[i];
+        char ratestr[4][32];
+        char bsizestr[16];
+        if (bsize < 0x400) snprintf(bsizestr, 16, "%luB", bsize);
+        else if (bsize < 0x100000) snprintf(bsizestr, 16, "%luK", bsize >> 10);
+        else snprintf(bsizestr, 16, "%luM", bsize >> 20);
+        ShowString("ベンチマーク: %s\nブロックサイズ %s...", name, bsizestr);
+        for (u32 t = 0; t < 4; t++) {
+            bool write = (t & 0x1);
+            bool random = (t & 0x2);
+            u64 rate = ((bsize <= buf_size) && (!write || writable)) ?
+                BenchmarkPass(path, buf, bsize, write, random) : 0;
+            if (!random && (rate > best_rate[write ? 1 : 0])) { // sequential rates drive the I/O chunk policy
+                best_rate[write ? 1 : 0] = rate;
+                *(write ? best_write : best_read) = bsize;
+            }
+            if (rate) {
+                FormatBytes(ratestr[t], rate);
+                strncat(ratestr[t], "/s", 32 - strnlen(ratestr[t], 32) - 1);
+            } else snprintf(ratestr[t], 32, "-");
+        }
+        len += snprintf(report + len, max_len - len, "%-6s %11s %11s %11s %11s\n",
+            bsizestr, ratestr[0], ratestr[1], ratestr[2], ratestr[3]);
+    }
+    if (!prepared && (len < max_len)) len += snprintf(report + len, max_len - len, "利用できません\n");
+
+    if (writable) PathDelete(path);
+    return (len < max_len) ? 0 : 1;
+}
+
+// sequential / random read and write throughput for SD, RAM drive and NAND (read only)
+u32 DeviceBenchmark(void) {
+    u32 buf_size = bench_block_size[BENCH_N_SIZES-1];
+    u8* buf = NULL;
+    ArenaMarker arena_mark = ArenaMark();
+    char* report = (char*) ArenaAlloc(STD_BUFFER_SIZE);
+    if (!report) return 1;
+    while (!(buf = (u8*) ArenaAlloc(buf_size)) && (buf_size > 0x8000))
+        buf_size >>= 1; // larger block sizes are skipped then
+    if (!buf) {
+        ArenaRelease(arena_mark);
+        return 1;
+    }
+    memset(buf, 0xA5, buf_size);
+
+    snprintf(report, STD_BUFFER_SIZE, "GodMode9 ベンチマーク\nテストサイズ: %luMB / 最大 %lu 操作\n",
+        BENCH_TEST_SIZE >> 20, (u32) BENCH_MAX_OPS);
+
+    u32 best_read[IOCLASS_N] = { 0 };
+    u32 best_write[IOCLASS_N] = { 0 };
+    fvx_rmkdir(OUTPUT_PATH);
+    BenchmarkDevice(report, STD_BUFFER_SIZE, "SDカード", BENCH_SD_FILE, true, buf, buf_size,
+        &best_read[IOCLASS_SD], &best_write[IOCLASS_SD]);
+    if (DriveType("9:") && CheckWritePermissions("9:"))
+        BenchmarkDevice(report, STD_BUFFER_SIZE, "RAMドライブ", "9:/bench.tmp", true, buf, buf_size,
+            &best_read[IOCLASS_RAM], &best_write[IOCLASS_RAM]);
+    BenchmarkDevice(report, STD_BUFFER_SIZE, "SysNAND", "S:/nand.bin", false, buf, buf_size,
+        &best_read[IOCLASS_NAND], &best_write[IOCLASS_NAND]);
+
+    u32 len = strnlen(report, STD_BUFFER_SIZE);
+    if (SetIoChunkPolicy(best_read, best_write) == 0)
+        len += snprintf(report + len, STD_BUFFER_SIZE - len, "\nI/Oチャンクサイズを " IOCHUNK_CFG " に保存しました\n");
+    FileSetData(BENCH_REPORT, report, len, 0, true);
+    MemTextViewer(report, len, 1, false);
+
+    ArenaRelease(arena_mark);
+    return 0;
+}
+
 u32 HomeMoreMenu(char* current_path) {
     NandPartitionInfo np_info;
     if (GetNandPartitionInfo(&np_info, NP_TYPE_BONUS, NP_SUBTYPE_CTR, 0, NAND_SYSNAND) != 0) np_info.count = 0;
 
-    const char* optionstr[8];
+    const char* optionstr[16];
     const char* promptstr = "HOME その他... メニュー.\nアクションを選択:";
     u32 n_opt = 0;
     int sdformat = ++n_opt;
     int bonus = (np_info.count > 0x2000) ? (int) ++n_opt : -1; // 4MB minsize
     int multi = (CheckMultiEmuNand()) ? (int) ++n_opt : -1;
     int bsupport = ++n_opt;
+    int nandinc = (IS_UNLOCKED) ? (int) ++n_opt : -1;
     int hsrestore = ((CheckHealthAndSafetyInject("1:") == 0) || (CheckHealthAndSafetyInject("4:") == 0)) ? (int) ++n_opt : -1;
     int clock = ++n_opt;
     int bright = ++n_opt;
     int calib = ++n_opt;
     int sysinfo = ++n_opt;
+    int bench = ++n_opt;
     int readme = (FindVTarFileInfo(VRAM0_README_MD, NULL)) ? (int) ++n_opt : -1;
 
     if (sdformat > 0) optionstr[sdformat - 1] = "SDカードフォーマットメニュー";
     if (bonus > 0) optionstr[bonus - 1] = "Bonusドライブセットアップ";
     if (multi > 0) optionstr[multi - 1] = "EmuNAND切り替え";
     if (bsupport > 0) optionstr[bsupport - 1] = "サポートファイルの構築";
+    if (nandinc > 0) optionstr[nandinc - 1] = "NANDの増分バックアップ";
     if (hsrestore > 0) optionstr[hsrestore - 1] = "H&Sをリストア";
     if (clock > 0) optionstr[clock - 1] = "RTCの日付と時刻を設定";
     if (bright > 0) optionstr[bright - 1] = "明るさを設定";
     if (calib > 0) optionstr[calib - 1] = "タッチスクリーンのキャリブレーション";
     if (sysinfo > 0) optionstr[sysinfo - 1] = "システム情報";
+    if (bench > 0) optionstr[bench - 1] = "ベンチマーク (SD/RAM/NAND)";
     if (readme > 0) optionstr[readme - 1] = "ReadMeを表示";
 
     int user_select = ShowSelectPrompt(n_opt, optionstr, promptstr);
@@ -2211,6 +3479,7 @@ u32 HomeMoreMenu(char* current_path) {
         ClearScreenF(true, true, COLOR_STD_BG);
         AutoEmuNandBase(true);
         InitExtFS();
+        FileTypeCacheFlush(); // same paths, different contents after a format / remount
         GetDirContents(current_dir, current_path);
         return 0;
     }
@@ -2218,6 +3487,7 @@ u32 HomeMoreMenu(char* current_path) {
         if (clipboard->n_entries && (DriveType(clipboard->entry[0].path) & (DRV_BONUS|DRV_IMAGE)))
             clipboard->n_entries = 0; // remove bonus drive clipboard entries
         if (!SetupBonusDrive()) ShowPrompt(false, "セットアップ失敗!");
+        FileTypeCacheFlush();
         ClearScreenF(true, true, COLOR_STD_BG);
         GetDirContents(current_dir, current_path);
         return 0;
@@ -2229,6 +3499,7 @@ u32 HomeMoreMenu(char* current_path) {
             DismountDriveType(DRV_EMUNAND);
             AutoEmuNandBase(false);
             InitExtFS();
+            FileTypeCacheFlush();
         }
         GetDirContents(current_dir, current_path);
         return 0;
@@ -2271,6 +3542,43 @@ u32 HomeMoreMenu(char* current_path) {
         GetDirContents(current_dir, current_path);
         return 0;
     }
+    else if (user_select == nandinc) { // incremental SysNAND backup
+        char chain_name[16 + 1] = "sysnand";
+        char chain_path[64];
+        if (!ShowKeyboardOrPrompt(chain_name, 16 + 1, "増分バックアップのチェーン名を入力:")) return 0;
+        snprintf(chain_path, 64, NANDINC_PATH "/%s", chain_name);
+        optionstr[0] = "増分バックアップを作成";
+        optionstr[1] = "NANDイメージを再構築";
+        user_select = ShowSelectPrompt(2, optionstr, "%s\nアクションを選択:", chain_path);
+        if (user_select == 1) {
+            u32 n_changed, n_blocks;
+            u64 timer = timer_start();
+            fvx_rmkdir(chain_path);
+            bool success = (NandIncBackup(chain_path, &n_changed, &n_blocks) == 0);
+            u64 msec = timer_msec(timer);
+            char changedstr[32];
+            FormatBytes(changedstr, (u64) n_changed * NANDINC_BLOCK_SIZE);
+            ShowPrompt(false, "%s\n増分バックアップ %s\n変更: %s (%lu/%lu ブロック)\n時間: %llu.%llus", chain_path,
+                success ? "成功" : "失敗", changedstr, n_changed, n_blocks, msec / 1000, (msec % 1000) / 100);
+        } else if (user_select == 2) {
+            NandIncHeader hdr;
+            char manifest[128];
+            char dest[128];
+            snprintf(manifest, 128, "%s/manifest.bin", chain_path);
+            if ((fvx_qread(manifest, &hdr, 0, sizeof(NandIncHeader), NULL) != FR_OK) ||
+                (memcmp(hdr.magic, NANDINC_MAGIC, 8) != 0)) {
+                ShowPrompt(false, "%s\n有効なバックアップチェーンがありません", chain_path);
+                return 0;
+            }
+            u64 n_inc = ShowNumberPrompt(hdr.n_incs, "%s\n再構築する時点を入力 (0 - %lu):", chain_path, hdr.n_incs);
+            if ((n_inc == (u64) -1) || (n_inc > hdr.n_incs)) return 0;
+            snprintf(dest, 128, OUTPUT_PATH "/%s_inc%04lu_nand.bin", chain_name, (u32) n_inc);
+            ShowPrompt(false, "%s\nNANDイメージの再構築 %s", dest,
+                (NandIncReconstruct(chain_path, (u32) n_inc, dest) == 0) ? "成功" : "失敗");
+        }
+        GetDirContents(current_dir, current_path);
+        return 0;
+    }
     else if (user_select == hsrestore) { // restore Health & Safety
         n_opt = 0;
         int sys = (CheckHealthAndSafetyInject("1:") == 0) ? (int) ++n_opt : -1;
@@ -2311,11 +3619,20 @@ u32 HomeMoreMenu(char* current_path) {
         return 0;
     }
     else if (user_select == sysinfo) { // Myria's system info
-        char* sysinfo_txt = (char*) malloc(STD_BUFFER_SIZE);
+        ArenaMarker arena_mark = ArenaMark();
+        char* sysinfo_txt = (char*) ArenaAlloc(STD_BUFFER_SIZE);
         if (!sysinfo_txt) return 1;
         MyriaSysinfo(sysinfo_txt);
         MemTextViewer(sysinfo_txt, strnlen(sysinfo_txt, STD_BUFFER_SIZE), 1, false);
-        free(sysinfo_txt);
+        ArenaRelease(arena_mark);
+        return 0;
+    }
+    else if (user_select == bench) { // SD / RAM drive / NAND benchmark
+        if (ShowPrompt(true, "ベンチマークを実行しますか?\n結果は以下に保存されます:\n" BENCH_REPORT)) {
+            if (DeviceBenchmark() != 0) ShowPrompt(false, "ベンチマークに失敗しました");
+            ClearScreenF(true, true, COLOR_STD_BG);
+            GetDirContents(current_dir, current_path);
+        }
         return 0;
     }
     else if (user_select == readme) { // Display GodMode9 readme
@@ -2389,22 +3706,25 @@ u32 GodMode(int entrypoint) {
     if (LoadSupportFile("gm9bright.cfg", &brightness, 0x4))
         SetScreenBrightness(brightness);
 
+    // scratch memory for menus, allocated before anything can fragment the heap
+    ArenaInit();
+
     // custom font handling
+    ArenaMarker font_mark = ArenaMark();
     if (CheckSupportFile("font.frf")) {
-        u8* riff = (u8*) malloc(0x20000); // arbitrary, should be enough by far
+        u8* riff = (u8*) ArenaAlloc(0x20000); // arbitrary, should be enough by far
         if (riff) {
             u32 riff_size = LoadSupportFile("font.frf", riff, 0x20000);
             if (riff_size) SetFont(riff, riff_size);
-            free(riff);
         }
     } else if (CheckSupportFile("font.pbm")) {
-        u8* pbm = (u8*) malloc(0x10000); // arbitrary, should be enough by far
+        u8* pbm = (u8*) ArenaAlloc(0x10000); // arbitrary, should be enough by far
         if (pbm) {
             u32 pbm_size = LoadSupportFile("font.pbm", pbm, 0x10000);
             if (pbm_size) SetFont(pbm, pbm_size);
-            free(pbm);
         }
     }
+    ArenaRelease(font_mark);
 
     // check for embedded essential backup
     if (((entrypoint == ENTRY_NANDBOOT) || (entrypoint == ENTRY_B9S)) &&
@@ -2504,6 +3824,7 @@ u32 GodMode(int entrypoint) {
             SetTitleManagerMode(false);
             DeinitExtFS(); // deinit and...
             InitExtFS(); // reinitialize extended file system
+            FileTypeCacheFlush();
             GetDirContents(current_dir, current_path);
             cursor = 0;
             if (!current_dir->n_entries) { // should not happen, if it does fail gracefully
@@ -2561,6 +3882,7 @@ u32 GodMode(int entrypoint) {
                 TruncateString(namestr, (*current_path) ? curr_entry->path : curr_entry->name, 32, 8);
                 int user_select = ShowSelectPrompt(n_opt, optionstr, "%s", namestr);
                 if (user_select == tman) {
+                    FileTypeCacheFlush();
                     if (InitImgFS(tpath)) {
                         SetTitleManagerMode(true);
                         snprintf(current_path, 256, "Y:");
@@ -2619,7 +3941,11 @@ u32 GodMode(int entrypoint) {
         } else if ((pad_state & BUTTON_A) && (curr_entry->type == T_FILE)) { // process a file
             if (!curr_entry->marked) ShowGameFileIcon(curr_entry->path, ALT_SCREEN);
             DrawTopBar(current_path);
+            u32 heap_mark = HeapTrackMark();
+            ArenaMarker arena_mark = ArenaMark();
             FileHandlerMenu(current_path, &cursor, &scroll, &pane); // processed externally
+            ArenaRelease(arena_mark); // catches early returns
+            HeapTrackCheck(heap_mark, "FileHandlerMenu");
             ClearScreenF(true, true, COLOR_STD_BG);
         } else if (*current_path && ((pad_state & BUTTON_B) || // one level down
             ((pad_state & BUTTON_A) && (curr_entry->type == T_DOTDOT)))) {
@@ -2653,6 +3979,7 @@ u32 GodMode(int entrypoint) {
             ClearScreenF(true, true, COLOR_STD_BG);
             AutoEmuNandBase(true);
             InitExtFS();
+            FileTypeCacheFlush();
             GetDirContents(current_dir, current_path);
             if (cursor >= current_dir->n_entries) cursor = 0;
         } else if (!switched && (pad_state & BUTTON_DOWN) && (cursor + 1 < current_dir->n_entries))  { // cursor down
@@ -2701,6 +4028,7 @@ u32 GodMode(int entrypoint) {
                 if (clipboard->n_entries && (DriveType(clipboard->entry[0].path) & DRV_IMAGE))
                     clipboard->n_entries = 0; // remove last mounted image clipboard entries
                 SetTitleManagerMode(false);
+                FileTypeCacheFlush();
                 InitImgFS(NULL);
                 ClearScreenF(false, true, COLOR_STD_BG);
                 GetDirContents(current_dir, current_path);
@@ -2721,11 +4049,16 @@ u32 GodMode(int entrypoint) {
                 if (n_marked) {
                     if (ShowPrompt(true, "パス %u を削除しますか?", n_marked)) {
                         u32 n_errors = 0;
-                        ShowString("ファイルを削除しています、しばらくお待ちください...");
-                        for (u32 c = 0; c < current_dir->n_entries; c++)
-                            if (current_dir->entry[c].marked && !PathDelete(current_dir->entry[c].path))
-                                n_errors++;
+                        u32 n_done = 0;
+                        ShowProgress(0, 0, "");
+                        for (u32 c = 0; c < current_dir->n_entries; c++) {
+                            if (!current_dir->entry[c].marked) continue;
+                            if (!ShowProgress(n_done, n_marked, current_dir->entry[c].name)) break;
+                            if (!PathDelete(current_dir->entry[c].path)) n_errors++;
+                            n_done++;
+                        }
                         ClearScreenF(true, false, COLOR_STD_BG);
+                        if (n_done < n_marked) ShowPrompt(false, "削除を中止しました\n%u/%u パスを処理しました。", n_done, n_marked);
                         if (n_errors) ShowPrompt(false, " %u/%u パスの削除に失敗しました。", n_errors, n_marked);
                     }
                 } else if (curr_entry->type != T_DOTDOT) {
@@ -2821,10 +4154,17 @@ u32 GodMode(int entrypoint) {
                     char ename[256];
                     u64 fsize = 0;
                     snprintf(ename, 255, (type == 1) ? "新規ディレクトリ" : "dummy.bin");
+                    bool zero_fill = false;
                     if ((ShowKeyboardOrPrompt(ename, 256, "ここで新しい %s を作成しますか？\n以下に名前を入力してください。", typestr)) &&
                         ((type != 2) || ((fsize = ShowNumberPrompt(0, "ここで新しい %s を作成しますか？\nファイルサイズを下に入力してください。", typestr)) != (u64) -1))) {
+                        // allocation only is fast, zero fill has to write the whole file
+                        if ((type == 2) && fsize)
+                            zero_fill = ShowPrompt(true, "%s\nファイルをゼロで埋めますか？\n(大きなファイルでは時間がかかります)", ename);
+                        char fpath[256];
+                        snprintf(fpath, 256, "%s/%s", current_path, ename);
                         if (((type == 1) && !DirCreate(current_path, ename)) ||
-                            ((type == 2) && !FileCreateDummy(current_path, ename, fsize))) {
+                            ((type == 2) && !FileCreateDummy(current_path, ename, fsize)) ||
+                            ((type == 2) && zero_fill && (FileZeroFill(fpath) != 0))) {
                             char namestr[UTF_BUFFER_BYTESIZE(36)];
                             TruncateString(namestr, ename, 36, 12);
                             ShowPrompt(false, "作成に失敗しました %s:\n%s", typestr, namestr);
@@ -2864,8 +4204,14 @@ u32 GodMode(int entrypoint) {
             while ((user_select = ShowSelectPrompt(n_opt, optionstr, "%s ボタンが押されました。\nアクションを選択:", buttonstr)) &&
                 (user_select != poweroff) && (user_select != reboot)) {
                 char loadpath[256];
-                if ((user_select == more) && (HomeMoreMenu(current_path) == 0)) break; // more... menu
-                else if (user_select == titleman) {
+                if (user_select == more) { // more... menu
+                    u32 heap_mark = HeapTrackMark();
+                    ArenaMarker arena_mark = ArenaMark();
+                    u32 ret = HomeMoreMenu(current_path);
+                    ArenaRelease(arena_mark); // catches early returns
+                    HeapTrackCheck(heap_mark, "HomeMoreMenu");
+                    if (ret == 0) break;
+                } else if (user_select == titleman) {
                     static const char* tmoptionstr[4] = {
                         "[A:] SDカード",
                         "[1:] NAND / TWL",
@@ -2883,6 +4229,7 @@ u32 GodMode(int entrypoint) {
                         (CheckVirtualDrive("E:")) ? 4 : 2, tmoptionstr,
                         "タイトルマネージャーメニュー\nタイトルソースの選択:", buttonstr))) {
                         const char* tpath = tmpaths[tmnum-1];
+                        FileTypeCacheFlush();
                         if (InitImgFS(tpath)) {
                             SetTitleManagerMode(true);
                             snprintf(current_path, 256, "Y:");
@@ -2931,8 +4278,10 @@ u32 GodMode(int entrypoint) {
             ClearScreenF(true, true, COLOR_STD_BG);
             AutoEmuNandBase(true);
             InitExtFS();
+            FileTypeCacheFlush();
             GetDirContents(current_dir, current_path);
         } else if ((pad_state & SD_EJECT) && CheckSDMountState()) {
+            FileTypeCacheFlush();
             ShowPrompt(false, "!SDカードの予期せぬ取り外し!\n \nデータの損失を防ぐため、SDカードを取り出す前に\nアンマウントしてください。");
             DeinitExtFS();
             DeinitSDCardFS();